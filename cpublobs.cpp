@@ -0,0 +1,204 @@
+/*
+        SmoothLife
+
+        random blobs to start a buffer with, see cpublobs.h
+*/
+
+#include "cpublobs.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cputhreads.h"
+
+// splitmix64 finalizer, scrambles x into a 64 bit random number
+//
+static unsigned long long mix64(unsigned long long x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// random number 0 <= n < 1 for component k of blob i, depends on nothing else
+//
+static double blobrnd(unsigned seed, long i, int k) {
+  unsigned long long h =
+      mix64(((unsigned long long)seed << 32) ^ mix64(4ULL * i + k));
+  return (double)(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// x modulo n, also for negative x
+//
+static int wrap(int x, int n) { return ((x % n) + n) % n; }
+
+// the cells i with |c-i| < u lie in lo..hi
+//
+static void cellrange(double c, double u, int *lo, int *hi) {
+  *lo = (int)floor(c - u);
+  *hi = (int)ceil(c + u);
+}
+
+// coordinate of blob i along the axis that picks the slice
+//
+static double slicecenter(const struct blobset *s, long i) {
+  return s->dims == 3 ? s->b[4 * i + 2] : s->b[4 * i + 1];
+}
+
+// add blob i to the slices it touches, count only if list is 0
+//
+static void bin(struct blobset *s, long i, long *fill, int *list) {
+  int lo, hi, k;
+
+  if (s->dims == 1) {
+    lo = hi = 0;
+  } else {
+    cellrange(slicecenter(s, i), s->b[4 * i + 3], &lo, &hi);
+    if (hi - lo + 1 >= s->nslice) {
+      lo = 0;
+      hi = s->nslice - 1;
+    }
+  }
+  for (k = lo; k <= hi; k++) {
+    int sl = wrap(k, s->nslice);
+    if (list) list[fill[sl]] = (int)i;
+    fill[sl]++;
+  }
+}
+
+bool blobs_make(struct blobset *s, int dims, int nx, int ny, int nz,
+                double ra, unsigned seed) {
+  double mx, my, mz;
+  long i;
+  int k;
+
+  memset(s, 0, sizeof(*s));
+  if (dims < 3) nz = 1;
+  if (dims < 2) ny = 1;
+  s->dims = dims;
+  s->NX = nx;
+  s->NY = ny;
+  s->NZ = nz;
+  s->nslice = dims == 3 ? nz : dims == 2 ? ny : 1;
+
+  mx = 2 * ra;
+  if (mx > nx) mx = nx;
+  my = ny > 1 ? 2 * ra : 1;
+  if (my > ny) my = ny;
+  mz = nz > 1 ? 2 * ra : 1;
+  if (mz > nz) mz = nz;
+  s->n = (long)((double)nx * ny * nz / (mx * my * mz)) + 1;
+
+  s->b = (double *)calloc(4 * s->n, sizeof(double));
+  s->first = (long *)calloc(s->nslice + 1, sizeof(long));
+  long *fill = (long *)calloc(s->nslice, sizeof(long));
+  if (!(s->b && s->first && fill)) {
+    free(fill);
+    blobs_free(s);
+    return false;
+  }
+
+  for (i = 0; i < s->n; i++) {
+    s->b[4 * i + 0] = nx * blobrnd(seed, i, 0);
+    s->b[4 * i + 1] = ny > 1 ? ny * blobrnd(seed, i, 1) : 0;
+    s->b[4 * i + 2] = nz > 1 ? nz * blobrnd(seed, i, 2) : 0;
+    s->b[4 * i + 3] = ra * (0.5 * blobrnd(seed, i, 3) + 0.5);
+  }
+
+  // count the blobs of each slice, then put them in the list in blob order
+  for (i = 0; i < s->n; i++) bin(s, i, fill, 0);
+  for (k = 0; k < s->nslice; k++) s->first[k + 1] = s->first[k] + fill[k];
+  s->list = (int *)calloc(s->first[s->nslice] + 1, sizeof(int));
+  if (!s->list) {
+    free(fill);
+    blobs_free(s);
+    return false;
+  }
+  memcpy(fill, s->first, s->nslice * sizeof(long));
+  for (i = 0; i < s->n; i++) bin(s, i, fill, s->list);
+
+  free(fill);
+  return true;
+}
+
+struct filljob {
+  const struct blobset *s;
+  float *a;
+  int s0;
+};
+
+// set the cells of row a (one line along x) within the blob at x=cx, that
+// are already d2 away from its center along the other axes
+//
+static void fillrow(float *a, int nx, double cx, double u, double d2) {
+  int lo, hi, ix;
+
+  cellrange(cx, sqrt(u * u - d2), &lo, &hi);
+  for (ix = lo; ix <= hi; ix++) {
+    double dx = cx - ix;
+    if (dx * dx + d2 < u * u) a[wrap(ix, nx)] = 1.0f;
+  }
+}
+
+// fill one slice with 0 and its blobs
+//
+static void task_fill(void *ctx, int task, int thread) {
+  struct filljob *j = (struct filljob *)ctx;
+  const struct blobset *s = j->s;
+  int sl = j->s0 + task;
+  long cells = s->dims == 3 ? (long)s->NX * s->NY : s->NX;
+  float *a = j->a + task * cells;
+
+  memset(a, 0, cells * sizeof(float));
+
+  for (long l = s->first[sl]; l < s->first[sl + 1]; l++) {
+    const double *b = s->b + 4 * s->list[l];
+    double u = b[3];
+    int lo, hi, k;
+
+    if (s->dims == 1) {
+      fillrow(a, s->NX, b[0], u, 0);
+      continue;
+    }
+
+    // every image of the blob that crosses this slice (more than one if
+    // the blob wraps around the whole buffer)
+    cellrange(slicecenter(s, s->list[l]), u, &lo, &hi);
+    for (k = lo + wrap(sl - lo, s->nslice); k <= hi; k += s->nslice) {
+      double dk = slicecenter(s, s->list[l]) - k;
+      double d2 = dk * dk;
+      if (d2 >= u * u) continue;
+
+      if (s->dims == 2) {
+        fillrow(a, s->NX, b[0], u, d2);
+        continue;
+      }
+
+      int ylo, yhi, iy;
+      cellrange(b[1], sqrt(u * u - d2), &ylo, &yhi);
+      for (iy = ylo; iy <= yhi; iy++) {
+        double dy = b[1] - iy;
+        if (dy * dy + d2 >= u * u) continue;
+        fillrow(a + (long)wrap(iy, s->NY) * s->NX, s->NX, b[0], u,
+                dy * dy + d2);
+      }
+    }
+  }
+}
+
+void blobs_fill(const struct blobset *s, float *a, int s0, int ns) {
+  struct filljob j;
+
+  j.s = s;
+  j.a = a;
+  j.s0 = s0;
+  parallel_for(ns, task_fill, &j);
+}
+
+void blobs_free(struct blobset *s) {
+  free(s->b);
+  free(s->first);
+  free(s->list);
+  memset(s, 0, sizeof(*s));
+}
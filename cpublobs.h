@@ -0,0 +1,39 @@
+/*
+        SmoothLife
+
+        random blobs to start a buffer with, the same for a seed whatever the
+        number of threads: center and radius of blob i come from a counter
+        based hash of (seed, i) instead of rand(), the blobs are sorted into
+        the slices they touch (z in 3D, y in 2D, one slice in 1D) and the
+        slices are filled in parallel, a blob only ever sets cells to 1
+*/
+
+#ifndef CPUBLOBS_H
+#define CPUBLOBS_H
+
+struct blobset {
+  int dims;        // n dimensions 1, 2 or 3
+  int NX, NY, NZ;  // buffer size, NY=NZ=1 in 1D, NZ=1 in 2D
+  long n;          // n blobs
+  double *b;       // center x, y, z and radius of each blob (4 per blob)
+  int nslice;      // n slices: NZ in 3D, NY in 2D, 1 in 1D
+  long *first;     // the blobs touching slice s are
+  int *list;       // list[first[s]] .. list[first[s+1]-1]
+};
+
+// make the blobs of seed for a dims dimensional nx*ny*nz buffer, about one
+// per (2ra)^dims cells with radius ra/2..ra, false if out of memory
+//
+bool blobs_make(struct blobset *s, int dims, int nx, int ny, int nz,
+                double ra, unsigned seed);
+
+// fill the ns slices s0..s0+ns-1 into a (which holds just these slices) with
+// 0 and the blobs, the slices are spread over the threads with parallel_for
+//
+void blobs_fill(const struct blobset *s, float *a, int s0, int ns);
+
+// free the blob lists
+//
+void blobs_free(struct blobset *s);
+
+#endif
@@ -0,0 +1,210 @@
+/*
+        SmoothLife
+
+        ensemble of independent universes for the CPU engine, see
+        cpuensemble.h
+*/
+
+#include "cpuensemble.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cputhreads.h"
+
+const long MULTASK = 16384;  // complex values per kernel multiply task
+const long SNMTASK = 256 * SNMBLOCK;  // cells per snm task
+const long ENSCELLS = 1L << 17;       // members stepped together have at
+                                      // most this many cells (or are one)
+
+struct ensjob {
+  struct cpuensemble *e;
+  int b0;     // first member of the batch
+  long n;     // values per member
+  int tasks;  // tasks per member
+};
+
+// multiply a part of a member's FT with its ring and disk kernel
+//
+static void task_mul(void *ctx, int task, int thread) {
+  struct ensjob *j = (struct ensjob *)ctx;
+  struct cpuensemble *e = j->e;
+  int c = task / j->tasks;  // member in the batch
+  int b = j->b0 + c;
+  long i0 = (task % j->tasks) * MULTASK;
+  long i1 = i0 + MULTASK < j->n ? i0 + MULTASK : j->n;
+
+  cpulife_kernelmul(e->af + 2 * c * j->n, e->krf + 2 * e->kern[b] * j->n,
+                    e->kdf + 2 * e->kern[b] * j->n,
+                    e->anmf + 2 * (2 * c) * j->n,
+                    e->anmf + 2 * (2 * c + 1) * j->n, i0, i1);
+}
+
+// apply a member's snm function to a part of it
+//
+static void task_snm(void *ctx, int task, int thread) {
+  struct ensjob *j = (struct ensjob *)ctx;
+  struct cpuensemble *e = j->e;
+  int c = task / j->tasks;  // member in the batch
+  int b = j->b0 + c;
+  long i0 = (task % j->tasks) * SNMTASK;
+  long i1 = i0 + SNMTASK < j->n ? i0 + SNMTASK : j->n;
+  const float *an = e->anm + 2 * c * j->n;
+  const float *am = e->anm + (2 * c + 1) * j->n;
+  float *aa = e->aa + b * j->n;
+
+  for (long i = i0; i < i1; i += SNMBLOCK) {
+    int nb = i1 - i < SNMBLOCK ? (int)(i1 - i) : SNMBLOCK;
+    snm_block(&e->sf[b], an + i, am + i, aa + i, nb);
+  }
+}
+
+void cpuensemble_step(struct cpuensemble *e) {
+  long nr = (long)e->NX * e->NY * e->NZ;
+  long nf = 2L * e->FX * e->NY * e->NZ;
+  struct ensjob j;
+  int b;
+
+  j.e = e;
+  for (b = 0; b < e->K; b++) snm_prepare(&e->sf[b], &e->p[b]);
+
+  for (j.b0 = 0; j.b0 < e->K; j.b0 += e->batch) {
+    int nb = e->K - j.b0 < e->batch ? e->K - j.b0 : e->batch;
+
+    cpufft_r2c_batch(&e->fft, e->aa + j.b0 * nr, e->af, nb);
+
+    j.n = nf / 2;
+    j.tasks = (int)((j.n + MULTASK - 1) / MULTASK);
+    parallel_for(nb * j.tasks, task_mul, &j);
+
+    cpufft_c2r_batch(&e->fft, e->anmf, e->anm, 2 * nb);
+
+    j.n = nr;
+    j.tasks = (int)((j.n + SNMTASK - 1) / SNMTASK);
+    parallel_for(nb * j.tasks, task_snm, &j);
+  }
+
+  e->stepnr++;
+}
+
+void cpuensemble_inita(struct cpuensemble *e, unsigned seed) {
+  long n = (long)e->NX * e->NY * e->NZ;
+
+  for (int b = 0; b < e->K; b++)
+    cpulife_blobs(e->aa + b * n, e->NX, e->NY, e->NZ, e->p[b].ra, seed + b);
+  e->stepnr = 0;
+}
+
+double cpuensemble_mean(const struct cpuensemble *e, int b) {
+  long n = (long)e->NX * e->NY * e->NZ;
+  const float *aa = e->aa + b * n;
+  double s = 0.0;
+
+  for (long i = 0; i < n; i++) s += aa[i];
+  return s / n;
+}
+
+// the members that share ra, rr, rb get the same kernel spectrum, build one
+// for each different kernel
+//
+static bool makekernels(struct cpuensemble *e) {
+  long nr = (long)e->NX * e->NY * e->NZ;
+  long nf = 2L * e->FX * e->NY * e->NZ;
+  int b, c;
+
+  e->nkern = 0;
+  for (b = 0; b < e->K; b++) {
+    for (c = 0; c < b; c++)
+      if (e->p[c].ra == e->p[b].ra && e->p[c].rr == e->p[b].rr &&
+          e->p[c].rb == e->p[b].rb)
+        break;
+    e->kern[b] = c < b ? e->kern[c] : e->nkern++;
+  }
+
+  e->krf = (float *)calloc(e->nkern * nf, sizeof(float));
+  e->kdf = (float *)calloc(e->nkern * nf, sizeof(float));
+  e->kflr = (double *)calloc(e->nkern, sizeof(double));
+  e->kfld = (double *)calloc(e->nkern, sizeof(double));
+  float *kr = (float *)calloc(nr, sizeof(float));
+  float *kd = (float *)calloc(nr, sizeof(float));
+  if (!(e->krf && e->kdf && e->kflr && e->kfld && kr && kd)) {
+    free(kr);
+    free(kd);
+    return false;
+  }
+
+  for (c = 0; c < e->nkern; c++) {
+    for (b = 0; e->kern[b] != c; b++)
+      ;  // first member with kernel c
+    cpulife_kernel(&e->fft, &e->p[b], kr, kd, e->krf + c * nf,
+                   e->kdf + c * nf, &e->kflr[c], &e->kfld[c]);
+  }
+
+  free(kr);
+  free(kd);
+  return true;
+}
+
+bool cpuensemble_create(struct cpuensemble *e, int dims, int nx, int ny,
+                        int nz, int K, const struct parameterlist *p) {
+  memset(e, 0, sizeof(*e));
+
+  if (dims < 3) nz = 1;
+  if (dims < 2) ny = 1;
+  if (K < 1) return false;
+
+  e->dims = dims;
+  e->NX = nx;
+  e->NY = ny;
+  e->NZ = nz;
+  e->FX = nx / 2 + 1;
+  e->K = K;
+  e->batch = (int)(ENSCELLS / ((long)nx * ny * nz));
+  if (e->batch < 1) e->batch = 1;
+  if (e->batch > K) e->batch = K;
+
+  if (!cpufft_create(&e->fft, nx, ny, nz)) return false;
+
+  long nr = (long)nx * ny * nz;
+  long nf = 2L * e->FX * ny * nz;
+
+  e->p = (struct parameterlist *)calloc(K, sizeof(struct parameterlist));
+  e->kern = (int *)calloc(K, sizeof(int));
+  e->sf = (struct snmfunc *)calloc(K, sizeof(struct snmfunc));
+  e->aa = (float *)calloc(K * nr, sizeof(float));
+  e->anm = (float *)calloc(2 * e->batch * nr, sizeof(float));
+  e->af = (float *)calloc(e->batch * nf, sizeof(float));
+  e->anmf = (float *)calloc(2 * e->batch * nf, sizeof(float));
+
+  if (!(e->p && e->kern && e->sf && e->aa && e->anm && e->af && e->anmf)) {
+    cpuensemble_free(e);
+    return false;
+  }
+
+  for (int b = 0; b < K; b++) {
+    e->p[b] = p[b];
+    e->p[b].dims = dims;
+  }
+
+  if (!makekernels(e)) {
+    cpuensemble_free(e);
+    return false;
+  }
+  return true;
+}
+
+void cpuensemble_free(struct cpuensemble *e) {
+  free(e->p);
+  free(e->kern);
+  free(e->krf);
+  free(e->kdf);
+  free(e->kflr);
+  free(e->kfld);
+  free(e->aa);
+  free(e->anm);
+  free(e->af);
+  free(e->anmf);
+  free(e->sf);
+  cpufft_free(&e->fft);
+  memset(e, 0, sizeof(*e));
+}
@@ -0,0 +1,70 @@
+/*
+        SmoothLife
+
+        ensemble of independent universes for the CPU engine, all members
+        have the same grid and are stepped together: their buffers are
+        stacked, every FFT pass transforms all of them at once and members
+        with the same ra, rr, rb share one kernel spectrum, each member has
+        its own b1..d2, sn, sm, mode, dt, sigmode, sigtype, mixtype
+*/
+
+#ifndef CPUENSEMBLE_H
+#define CPUENSEMBLE_H
+
+#include "cpulife.h"
+#include "cpusnm.h"
+
+struct cpuensemble {
+  int dims;        // n dimensions 1, 2 or 3
+  int NX, NY, NZ;  // buffer size of each member (power of 2)
+  int FX;          // width of the Fourier buffers NX/2+1
+  int K;           // n members
+  int batch;       // n members stepped together (ENSCELLS)
+
+  struct parameterlist *p;  // paras of each member, may be changed between
+                            // steps except ra, rr, rb
+  int *kern;                // kernel spectrum of each member
+
+  // kernel spectra, one per different ra, rr, rb (FX*NY*NZ complex each,
+  // scaled like cpulife krf, kdf)
+  int nkern;
+  float *krf, *kdf;
+  double *kflr, *kfld;
+
+  // stacked buffers, member b at b*NX*NY*NZ (real) and b*FX*NY*NZ (Fourier),
+  // the scratch ones only hold the batch being stepped (member b0+c at c)
+  float *aa;    // K buffers
+  float *anm;   // batch ring and disk blured buffers (ring of c at 2c)
+  float *af;    // batch FT of buffers
+  float *anmf;  // batch ring and disk blured FT (ring of c at 2c)
+
+  struct snmfunc *sf;  // snm functions of each member, per step
+
+  struct cpufft fft;  // FFT plan of one member
+  long stepnr;        // n time steps done since the last cpuensemble_inita
+};
+
+// allocate K members on a dims dimensional nx*ny*nz grid with paras p[0..K-1]
+// (p->dims is ignored, dims counts) and build their kernels, false if out of
+// memory or size is not a power of 2
+//
+bool cpuensemble_create(struct cpuensemble *e, int dims, int nx, int ny,
+                        int nz, int K, const struct parameterlist *p);
+
+// free all buffers
+//
+void cpuensemble_free(struct cpuensemble *e);
+
+// fill member b with the random blobs of seed+b
+//
+void cpuensemble_inita(struct cpuensemble *e, unsigned seed);
+
+// do one time step of all members
+//
+void cpuensemble_step(struct cpuensemble *e);
+
+// mean value of member b
+//
+double cpuensemble_mean(const struct cpuensemble *e, int b);
+
+#endif
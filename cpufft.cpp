@@ -0,0 +1,325 @@
+/*
+        SmoothLife
+
+        multithreaded real to complex FFT for the CPU engine, see cpufft.h
+
+        All transforms work on batches of FFTLANES lines at once. A batch is
+        gathered into a thread local scratch buffer with the lines side by
+        side (element k of line v at k*FFTLANES+v, real and imag part in
+        separate arrays), so the butterflies run over FFTLANES contiguous
+        floats and get vectorized, and the strided y and z lines are read and
+        written in blocks of FFTLANES neighbouring columns (cache blocked
+        transpose). Along x the NX real values are transformed as NX/2
+        complex ones and split into the half spectrum afterwards.
+*/
+
+#include "cpufft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cputhreads.h"
+
+static const double PI =
+    6.28318530718;  // circle constant, relation circumference to radius
+
+// power of 2 of n, -1 if n is not a power of 2
+//
+static int log2i(int n) {
+  int b = 0;
+  while ((1 << b) < n) b++;
+  return (1 << b) == n ? b : -1;
+}
+
+static int bitreverse(int x, int b) {
+  int c, t;
+
+  c = 0;
+  for (t = 0; t < b; t++) {
+    c = (c << 1) | ((x >> t) & 1);
+  }
+  return c;
+}
+
+// twiddle factors cos, sin of PI*k/n for k < n/2 and bit reversed indices
+//
+static bool make_plan(int n, float **tw, int **rev) {
+  int b = log2i(n);
+
+  *tw = (float *)calloc(n > 1 ? n : 2, sizeof(float));
+  *rev = (int *)calloc(n, sizeof(int));
+  if (*tw == 0 || *rev == 0) return false;
+
+  for (int k = 0; k < n / 2; k++) {
+    (*tw)[2 * k + 0] = (float)cos(PI * k / n);
+    (*tw)[2 * k + 1] = (float)sin(PI * k / n);
+  }
+  for (int k = 0; k < n; k++) (*rev)[k] = bitreverse(k, b);
+  return true;
+}
+
+// radix 2 FFT of nl <= FFTLANES lines of length n, already in bit reversed
+// order, si=-1 forward, si=1 inverse (not normalized)
+//
+static void fft_batch(float *__restrict re, float *__restrict im, int n,
+                      int nl, const float *tw, int si) {
+  const int L = FFTLANES;
+
+  for (int l = 2; l <= n; l <<= 1) {
+    int h = l / 2;
+    int ts = n / l;  // twiddle stride
+    for (int s = 0; s < n; s += l) {
+      for (int j = 0; j < h; j++) {
+        float wr = tw[2 * j * ts];
+        float wi = si * tw[2 * j * ts + 1];
+        float *__restrict ar = re + (s + j) * L;
+        float *__restrict ai = im + (s + j) * L;
+        float *__restrict cr = re + (s + j + h) * L;
+        float *__restrict ci = im + (s + j + h) * L;
+        for (int v = 0; v < nl; v++) {
+          float br = cr[v] * wr - ci[v] * wi;
+          float bi = cr[v] * wi + ci[v] * wr;
+          cr[v] = ar[v] - br;
+          ci[v] = ai[v] - bi;
+          ar[v] += br;
+          ai[v] += bi;
+        }
+      }
+    }
+  }
+}
+
+struct fftjob {
+  struct cpufft *p;
+  const float *a;  // real input
+  float *ao;       // real output
+  float *f;        // Fourier buffer
+  int axis, si;
+  int nb;  // n buffers one after the other
+};
+
+// x axis, real to half spectrum, one task is FFTLANES rows
+//
+static void task_r2c_x(void *ctx, int task, int thread) {
+  struct fftjob *j = (struct fftjob *)ctx;
+  struct cpufft *p = j->p;
+  const int L = FFTLANES;
+  int NX = p->NX, FX = p->FX, h = NX / 2;
+  long nrows = (long)p->NY * p->NZ * j->nb;
+  long r0 = (long)task * L;
+  int nl = nrows - r0 < L ? (int)(nrows - r0) : L;
+  float *re = p->scratch + (long)thread * 2 * L * p->nmax;
+  float *im = re + L * p->nmax;
+  const int *rev = p->rev[0];
+
+  for (int v = 0; v < nl; v++) {
+    const float *row = j->a + (r0 + v) * NX;
+    for (int k = 0; k < h; k++) {
+      re[rev[k] * L + v] = row[2 * k];
+      im[rev[k] * L + v] = row[2 * k + 1];
+    }
+  }
+
+  fft_batch(re, im, h, nl, p->tw[0], -1);
+
+  // X[k] = (Z[k]+conj(Z[h-k]))/2 + w^k (Z[k]-conj(Z[h-k]))/2i
+  for (int k = 0; k <= h; k++) {
+    int kk = k == h ? 0 : k;
+    int nk = k == 0 ? 0 : h - k;
+    float wr = p->rtw[2 * kk + 0], wi = -p->rtw[2 * kk + 1];
+    if (k == h) wr = -1.0f;
+    for (int v = 0; v < nl; v++) {
+      float zr = re[kk * L + v], zi = im[kk * L + v];
+      float yr = re[nk * L + v], yi = -im[nk * L + v];
+      float er = 0.5f * (zr + yr), ei = 0.5f * (zi + yi);
+      float or_ = 0.5f * (zi - yi), oi = -0.5f * (zr - yr);
+      float *o = j->f + 2 * ((r0 + v) * FX + k);
+      o[0] = er + wr * or_ - wi * oi;
+      o[1] = ei + wr * oi + wi * or_;
+    }
+  }
+}
+
+// x axis, half spectrum to real, one task is FFTLANES rows
+//
+static void task_c2r_x(void *ctx, int task, int thread) {
+  struct fftjob *j = (struct fftjob *)ctx;
+  struct cpufft *p = j->p;
+  const int L = FFTLANES;
+  int NX = p->NX, FX = p->FX, h = NX / 2;
+  long nrows = (long)p->NY * p->NZ * j->nb;
+  long r0 = (long)task * L;
+  int nl = nrows - r0 < L ? (int)(nrows - r0) : L;
+  float *re = p->scratch + (long)thread * 2 * L * p->nmax;
+  float *im = re + L * p->nmax;
+  const int *rev = p->rev[0];
+
+  // Z[k] = (X[k]+conj(X[h-k])) + i w^-k (X[k]-conj(X[h-k]))
+  for (int k = 0; k < h; k++) {
+    float wr = p->rtw[2 * k + 0], wi = p->rtw[2 * k + 1];
+    int rk = rev[k];
+    for (int v = 0; v < nl; v++) {
+      const float *x = j->f + 2 * ((r0 + v) * FX + k);
+      const float *y = j->f + 2 * ((r0 + v) * FX + h - k);
+      float xr = x[0], xi = x[1], yr = y[0], yi = -y[1];
+      float er = xr + yr, ei = xi + yi;
+      float dr = xr - yr, di = xi - yi;
+      float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+      re[rk * L + v] = er - oi;
+      im[rk * L + v] = ei + or_;
+    }
+  }
+
+  fft_batch(re, im, h, nl, p->tw[0], 1);
+
+  for (int v = 0; v < nl; v++) {
+    float *row = j->ao + (r0 + v) * NX;
+    for (int k = 0; k < h; k++) {
+      row[2 * k] = re[k * L + v];
+      row[2 * k + 1] = im[k * L + v];
+    }
+  }
+}
+
+// y or z axis in place on the Fourier buffer, one task is FFTLANES
+// neighbouring columns
+//
+static void task_yz(void *ctx, int task, int thread) {
+  struct fftjob *j = (struct fftjob *)ctx;
+  struct cpufft *p = j->p;
+  const int L = FFTLANES;
+  int n, stride, ninner;
+  long ostride;
+  float *re = p->scratch + (long)thread * 2 * L * p->nmax;
+  float *im = re + L * p->nmax;
+
+  if (j->axis == 1) {
+    n = p->NY;
+    stride = p->FX;
+    ninner = p->FX;
+    ostride = (long)p->FX * p->NY;
+  } else {
+    n = p->NZ;
+    stride = p->FX * p->NY;
+    ninner = p->FX * p->NY;
+    ostride = (long)p->FX * p->NY * p->NZ;
+  }
+
+  int nblocks = (ninner + L - 1) / L;
+  long o = task / nblocks;  // z slice for axis 1, buffer for axis 2
+  int i0 = (task % nblocks) * L;
+  int nl = ninner - i0 < L ? ninner - i0 : L;
+  float *base = j->f + 2 * (o * ostride + i0);
+  const int *rev = p->rev[j->axis];
+
+  for (int k = 0; k < n; k++) {
+    const float *s = base + 2 * (long)k * stride;
+    int rk = rev[k];
+    for (int v = 0; v < nl; v++) {
+      re[rk * L + v] = s[2 * v];
+      im[rk * L + v] = s[2 * v + 1];
+    }
+  }
+
+  fft_batch(re, im, n, nl, p->tw[j->axis], j->si);
+
+  for (int k = 0; k < n; k++) {
+    float *d = base + 2 * (long)k * stride;
+    for (int v = 0; v < nl; v++) {
+      d[2 * v] = re[k * L + v];
+      d[2 * v + 1] = im[k * L + v];
+    }
+  }
+}
+
+// make sure every thread has its scratch buffer
+//
+static bool check_scratch(struct cpufft *p) {
+  int n = cputhreads_count();
+
+  if (n <= p->nscratch) return true;
+  free(p->scratch);
+  p->scratch = (float *)calloc((long)n * 2 * FFTLANES * p->nmax, sizeof(float));
+  p->nscratch = p->scratch ? n : 0;
+  return p->scratch != 0;
+}
+
+// y and z axis of nb buffers
+//
+static void fft_yz(struct cpufft *p, float *f, int axis, int si, int nb) {
+  int n = axis == 1 ? p->NY : p->NZ;
+  int ninner = axis == 1 ? p->FX : p->FX * p->NY;
+  int nouter = axis == 1 ? p->NZ * nb : nb;
+  struct fftjob j = {p, 0, 0, f, axis, si, nb};
+
+  if (n == 1) return;
+  parallel_for(nouter * ((ninner + FFTLANES - 1) / FFTLANES), task_yz, &j);
+}
+
+void cpufft_r2c(struct cpufft *p, const float *a, float *f) {
+  cpufft_r2c_batch(p, a, f, 1);
+}
+
+void cpufft_c2r(struct cpufft *p, float *f, float *a) {
+  cpufft_c2r_batch(p, f, a, 1);
+}
+
+void cpufft_r2c_batch(struct cpufft *p, const float *a, float *f, int nb) {
+  long nrows = (long)p->NY * p->NZ * nb;
+  struct fftjob j = {p, a, 0, f, 0, -1, nb};
+
+  if (!check_scratch(p)) return;
+  parallel_for((int)((nrows + FFTLANES - 1) / FFTLANES), task_r2c_x, &j);
+  fft_yz(p, f, 1, -1, nb);
+  fft_yz(p, f, 2, -1, nb);
+}
+
+void cpufft_c2r_batch(struct cpufft *p, float *f, float *a, int nb) {
+  long nrows = (long)p->NY * p->NZ * nb;
+  struct fftjob j = {p, 0, a, f, 0, 1, nb};
+
+  if (!check_scratch(p)) return;
+  fft_yz(p, f, 2, 1, nb);
+  fft_yz(p, f, 1, 1, nb);
+  parallel_for((int)((nrows + FFTLANES - 1) / FFTLANES), task_c2r_x, &j);
+}
+
+bool cpufft_create(struct cpufft *p, int nx, int ny, int nz) {
+  memset(p, 0, sizeof(*p));
+
+  if (nx < 2 || log2i(nx) < 0 || log2i(ny) < 0 || log2i(nz) < 0) return false;
+
+  p->NX = nx;
+  p->NY = ny;
+  p->NZ = nz;
+  p->FX = nx / 2 + 1;
+  p->nmax = nx / 2;
+  if (ny > p->nmax) p->nmax = ny;
+  if (nz > p->nmax) p->nmax = nz;
+
+  p->rtw = (float *)calloc(nx, sizeof(float));
+  if (p->rtw == 0) return false;
+  for (int k = 0; k < nx / 2; k++) {
+    p->rtw[2 * k + 0] = (float)cos(PI * k / nx);
+    p->rtw[2 * k + 1] = (float)sin(PI * k / nx);
+  }
+
+  if (!make_plan(nx / 2, &p->tw[0], &p->rev[0]) ||
+      !make_plan(ny, &p->tw[1], &p->rev[1]) ||
+      !make_plan(nz, &p->tw[2], &p->rev[2]) || !check_scratch(p)) {
+    cpufft_free(p);
+    return false;
+  }
+  return true;
+}
+
+void cpufft_free(struct cpufft *p) {
+  for (int t = 0; t < 3; t++) {
+    free(p->tw[t]);
+    free(p->rev[t]);
+  }
+  free(p->rtw);
+  free(p->scratch);
+  memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,54 @@
+/*
+        SmoothLife
+
+        multithreaded real to complex FFT for the CPU engine
+
+        real buffers are NX*NY*NZ floats, Fourier buffers are the half
+        spectrum FX*NY*NZ with FX=NX/2+1, real and imag part interleaved,
+        the same layout as the AF/KRF/KDF textures in main.cpp
+*/
+
+#ifndef CPUFFT_H
+#define CPUFFT_H
+
+const int FFTLANES = 16;  // lines transformed together in one batch
+
+struct cpufft {
+  int NX, NY, NZ;  // buffer size (must be power of 2)
+  int FX;          // width of the Fourier buffers NX/2+1
+  int nmax;        // longest line of the batch FFTs
+
+  float *tw[3];  // twiddle factors of each axis (cos, sin interleaved)
+  int *rev[3];   // bit reversed indices of each axis
+  float *rtw;    // twiddle factors for the real/complex split along x
+
+  int nscratch;    // n thread scratch buffers
+  float *scratch;  // 2*FFTLANES*nmax floats per thread
+};
+
+// make the plan for an nx*ny*nz grid (ny=nz=1 in 1D, nz=1 in 2D), false if
+// out of memory or a size is not a power of 2 (nx must be at least 2)
+//
+bool cpufft_create(struct cpufft *p, int nx, int ny, int nz);
+
+// free the plan
+//
+void cpufft_free(struct cpufft *p);
+
+// real to Fourier (not normalized)
+//
+void cpufft_r2c(struct cpufft *p, const float *a, float *f);
+
+// Fourier to real (not normalized, r2c followed by c2r gives NX*NY*NZ*a),
+// f is used as scratch
+//
+void cpufft_c2r(struct cpufft *p, float *f, float *a);
+
+// the same for nb buffers one after the other (a and f are nb buffers long),
+// the lines of all of them are spread over the threads together, so many
+// small buffers keep the threads and the FFTLANES lanes busy
+//
+void cpufft_r2c_batch(struct cpufft *p, const float *a, float *f, int nb);
+void cpufft_c2r_batch(struct cpufft *p, float *f, float *a, int nb);
+
+#endif
@@ -0,0 +1,242 @@
+/*
+        SmoothLife
+
+        headless CPU engine, see cpulife.h
+*/
+
+#include "cpulife.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpublobs.h"
+#include "cpusnm.h"
+#include "cputhreads.h"
+
+const double PI =
+    6.28318530718;  // circle constant, relation circumference to radius
+
+void cpulife_kernelmul(const float *vo, const float *kr, const float *kd,
+                       float *nf, float *mf, long i0, long i1) {
+  for (long i = i0; i < i1; i++) {
+    float ar = vo[2 * i], ai = vo[2 * i + 1];
+    nf[2 * i + 0] = ar * kr[2 * i] - ai * kr[2 * i + 1];
+    nf[2 * i + 1] = ar * kr[2 * i + 1] + ai * kr[2 * i];
+    mf[2 * i + 0] = ar * kd[2 * i] - ai * kd[2 * i + 1];
+    mf[2 * i + 1] = ar * kd[2 * i + 1] + ai * kd[2 * i];
+  }
+}
+
+// step type for the kernel, same as in main.cpp
+//
+static double func_linear(double x, double a, double ea) {
+  if (x < a - ea / 2.0)
+    return 0.0;
+  else if (x > a + ea / 2.0)
+    return 1.0;
+  else
+    return (x - a) / ea + 0.5;
+}
+
+static double func_kernel(double x, double a, double ea) {
+  return func_linear(x, a, ea);
+}
+
+struct snmjob {
+  struct cpulife *sl;
+  struct snmfunc sf;
+  long n;
+};
+
+const int SNMTASK = 256 * SNMBLOCK;  // cells per parallel_for task
+
+static void task_snm(void *ctx, int task, int thread) {
+  struct snmjob *j = (struct snmjob *)ctx;
+  long i0 = (long)task * SNMTASK;
+  long i1 = i0 + SNMTASK < j->n ? i0 + SNMTASK : j->n;
+
+  for (long i = i0; i < i1; i += SNMBLOCK) {
+    int nb = i1 - i < SNMBLOCK ? (int)(i1 - i) : SNMBLOCK;
+    snm_block(&j->sf, j->sl->an + i, j->sl->am + i, j->sl->aa + i, nb);
+  }
+}
+
+// apply the snm function (real buffers), result goes to aa
+//
+static void snm(struct cpulife *sl) {
+  struct snmjob j;
+
+  j.sl = sl;
+  j.n = (long)sl->NX * sl->NY * sl->NZ;
+  snm_prepare(&j.sf, &sl->p);
+  parallel_for((int)((j.n + SNMTASK - 1) / SNMTASK), task_snm, &j);
+}
+
+void cpulife_kernel(struct cpufft *fft, const struct parameterlist *p,
+                    float *kr, float *kd, float *krf, float *kdf,
+                    double *kflr, double *kfld) {
+  int NX = fft->NX, NY = fft->NY, NZ = fft->NZ;
+  int ix, iy, iz, x, y, z, Ra;
+  double l, n, m, ri, bb;
+
+  ri = p->ra / p->rr;
+  bb = p->ra / p->rb;
+  Ra = (int)(p->ra * 2);
+
+  *kflr = 0.0;
+  *kfld = 0.0;
+
+  for (iz = 0; iz < NZ; iz++) {
+    z = iz < NZ / 2 ? iz : iz - NZ;
+    if (NZ == 1) z = 0;
+    for (iy = 0; iy < NY; iy++) {
+      y = iy < NY / 2 ? iy : iy - NY;
+      if (NY == 1) y = 0;
+      for (ix = 0; ix < NX; ix++) {
+        x = ix < NX / 2 ? ix : ix - NX;
+        long i = ((long)iz * NY + iy) * NX + ix;
+        m = 0.0;
+        n = 0.0;
+        if (x >= -Ra && x <= Ra && y >= -Ra && y <= Ra && z >= -Ra &&
+            z <= Ra) {
+          l = sqrt((double)x * x + (double)y * y + (double)z * z);
+          m = 1 - func_kernel(l, ri, bb);
+          n = func_kernel(l, ri, bb) * (1 - func_kernel(l, p->ra, bb));
+        }
+        kd[i] = (float)m;
+        kr[i] = (float)n;
+        *kflr += n;
+        *kfld += m;
+      }
+    }
+  }
+
+  cpufft_r2c(fft, kr, krf);
+  cpufft_r2c(fft, kd, kdf);
+
+  long nf = 2L * fft->FX * NY * NZ;
+  double N = (double)NX * NY * NZ;
+  float scr = (float)(1.0 / (*kflr * N));
+  float scd = (float)(1.0 / (*kfld * N));
+  for (long i = 0; i < nf; i++) {
+    krf[i] *= scr;
+    kdf[i] *= scd;
+  }
+}
+
+void cpulife_makekernel(struct cpulife *sl) {
+  cpulife_kernel(&sl->fft, &sl->p, sl->kr, sl->kd, sl->krf, sl->kdf,
+                 &sl->kflr, &sl->kfld);
+}
+
+void cpulife_blobs(float *aa, int nx, int ny, int nz, double ra,
+                   unsigned seed) {
+  struct blobset bs;
+  int dims = nz > 1 ? 3 : ny > 1 ? 2 : 1;
+
+  if (!blobs_make(&bs, dims, nx, ny, nz, ra, seed)) {
+    memset(aa, 0, (long)nx * ny * nz * sizeof(float));
+    return;
+  }
+  blobs_fill(&bs, aa, 0, bs.nslice);
+  blobs_free(&bs);
+}
+
+void cpulife_inita(struct cpulife *sl, unsigned seed) {
+  cpulife_blobs(sl->aa, sl->NX, sl->NY, sl->NZ, sl->p.ra, seed);
+  sl->stepnr = 0;
+  memset(sl->stagesec, 0, sizeof(sl->stagesec));
+}
+
+// wall clock in seconds
+//
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void cpulife_step(struct cpulife *sl) {
+  double t0 = seconds(), t1;
+
+  cpufft_r2c(&sl->fft, sl->aa, sl->af);
+  t1 = seconds();
+  sl->stagesec[STAGE_FFT] += t1 - t0;
+  cpulife_kernelmul(sl->af, sl->krf, sl->kdf, sl->anf, sl->amf, 0,
+                    (long)sl->FX * sl->NY * sl->NZ);
+  t0 = seconds();
+  sl->stagesec[STAGE_MUL] += t0 - t1;
+  cpufft_c2r(&sl->fft, sl->anf, sl->an);
+  cpufft_c2r(&sl->fft, sl->amf, sl->am);
+  t1 = seconds();
+  sl->stagesec[STAGE_IFFT] += t1 - t0;
+  snm(sl);
+  sl->stagesec[STAGE_SNM] += seconds() - t1;
+  sl->stepnr++;
+}
+
+double cpulife_mean(const struct cpulife *sl) {
+  long n = (long)sl->NX * sl->NY * sl->NZ;
+  double s = 0.0;
+
+  for (long i = 0; i < n; i++) s += sl->aa[i];
+  return s / n;
+}
+
+bool cpulife_create(struct cpulife *sl, int dims, int nx, int ny, int nz,
+                    const struct parameterlist *p) {
+  memset(sl, 0, sizeof(*sl));
+
+  if (dims < 3) nz = 1;
+  if (dims < 2) ny = 1;
+
+  sl->dims = dims;
+  sl->NX = nx;
+  sl->NY = ny;
+  sl->NZ = nz;
+  sl->FX = nx / 2 + 1;
+  sl->p = *p;
+  sl->p.dims = dims;
+
+  if (!cpufft_create(&sl->fft, nx, ny, nz)) return false;
+
+  long nr = (long)nx * ny * nz;
+  long nf = 2L * sl->FX * ny * nz;
+
+  sl->aa = (float *)calloc(nr, sizeof(float));
+  sl->kr = (float *)calloc(nr, sizeof(float));
+  sl->kd = (float *)calloc(nr, sizeof(float));
+  sl->an = (float *)calloc(nr, sizeof(float));
+  sl->am = (float *)calloc(nr, sizeof(float));
+  sl->af = (float *)calloc(nf, sizeof(float));
+  sl->krf = (float *)calloc(nf, sizeof(float));
+  sl->kdf = (float *)calloc(nf, sizeof(float));
+  sl->anf = (float *)calloc(nf, sizeof(float));
+  sl->amf = (float *)calloc(nf, sizeof(float));
+
+  if (!(sl->aa && sl->kr && sl->kd && sl->an && sl->am && sl->af && sl->krf &&
+        sl->kdf && sl->anf && sl->amf)) {
+    cpulife_free(sl);
+    return false;
+  }
+
+  cpulife_makekernel(sl);
+  return true;
+}
+
+void cpulife_free(struct cpulife *sl) {
+  free(sl->aa);
+  free(sl->kr);
+  free(sl->kd);
+  free(sl->an);
+  free(sl->am);
+  free(sl->af);
+  free(sl->krf);
+  free(sl->kdf);
+  free(sl->anf);
+  free(sl->amf);
+  cpufft_free(&sl->fft);
+  memset(sl, 0, sizeof(*sl));
+}
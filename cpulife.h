@@ -0,0 +1,92 @@
+/*
+        SmoothLife
+
+        headless CPU engine, does the same time step as the shader pass
+        chain in main.cpp (fft, kernelmul, fft, snm) without SDL or OpenGL
+*/
+
+#ifndef CPULIFE_H
+#define CPULIFE_H
+
+#include "cpufft.h"
+#include "cpuparas.h"
+
+// stages of a time step, cpulife_step adds up their seconds in stagesec
+enum { STAGE_FFT, STAGE_MUL, STAGE_IFFT, STAGE_SNM, STAGES };
+
+struct cpulife {
+  int dims;        // n dimensions 1, 2 or 3
+  int NX, NY, NZ;  // buffer size (must be power of 2), NY=NZ=1 in 1D
+  int FX;          // width of the Fourier buffers NX/2+1
+
+  struct parameterlist p;  // current paras, may be changed between steps
+
+  // real buffers NX*NY*NZ
+  float *aa;  // the buffer
+  float *kr;  // ring kernel
+  float *kd;  // disk kernel
+  float *an;  // buffer blured with ring kernel
+  float *am;  // buffer blured with disk kernel
+
+  // Fourier buffers (real and imag part interleaved, FX*NY*NZ complex)
+  float *af;   // FT of buffer
+  float *krf;  // FT of ring kernel, scaled by 1/(kflr*NX*NY*NZ)
+  float *kdf;  // FT of disk kernel, scaled by 1/(kfld*NX*NY*NZ)
+  float *anf;  // FT of buffer blured with ring kernel
+  float *amf;  // FT of buffer blured with disk kernel
+
+  double kflr, kfld;  // computed areas of disk and ring kernels
+
+  struct cpufft fft;  // FFT plan
+  long stepnr;        // n time steps done since the last cpulife_inita
+  double stagesec[STAGES];  // seconds in each stage since cpulife_inita
+};
+
+// allocate all buffers for a dims dimensional nx*ny*nz grid and build the
+// kernels for paras p (p->dims is ignored, dims counts), false if out of
+// memory or size is not a power of 2
+//
+bool cpulife_create(struct cpulife *sl, int dims, int nx, int ny, int nz,
+                    const struct parameterlist *p);
+
+// free all buffers
+//
+void cpulife_free(struct cpulife *sl);
+
+// rebuild ring and disk kernels and their spectra after ra, rr or rb changed
+//
+void cpulife_makekernel(struct cpulife *sl);
+
+// build the ring and disk kernels of paras p (ra, rr, rb) for the grid of fft
+// into kr, kd and their spectra, scaled like sl->krf and sl->kdf, into krf,
+// kdf, their areas go to kflr, kfld
+//
+void cpulife_kernel(struct cpufft *fft, const struct parameterlist *p,
+                    float *kr, float *kd, float *krf, float *kdf,
+                    double *kflr, double *kfld);
+
+// fill the buffer with the random blobs of seed (cpublobs.h)
+//
+void cpulife_inita(struct cpulife *sl, unsigned seed);
+
+// the same for any nx*ny*nz buffer aa and radius ra
+//
+void cpulife_blobs(float *aa, int nx, int ny, int nz, double ra,
+                   unsigned seed);
+
+// multiply the FT vo with the ring and disk kernel spectra kr, kd into nf, mf
+// for the complex values i0 to i1 (the ensemble uses it too, so its members
+// round like a single run)
+//
+void cpulife_kernelmul(const float *vo, const float *kr, const float *kd,
+                       float *nf, float *mf, long i0, long i1);
+
+// do one time step
+//
+void cpulife_step(struct cpulife *sl);
+
+// mean value of the buffer
+//
+double cpulife_mean(const struct cpulife *sl);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+        SmoothLife
+
+        config file parameter lines, see cpuparas.h
+*/
+
+#include "cpuparas.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int read_paralist(const char *fname, struct parameterlist *list, int max) {
+  FILE *file;
+  int l, t, d;
+  char buf[256], desc[256];
+  bool gef;
+
+  file = fopen(fname, "r");
+  if (file == 0) return -1;
+
+  l = 0;  // read lines
+  while (l < max && fgets(buf, 256, file)) {
+    if (!(buf[0] == '1' || buf[0] == '2' || buf[0] == '3')) continue;
+
+    struct parameterlist *p = &list[l];
+    sscanf(buf, "%d %d  %lf %lf %lf %lf  %lf %lf %lf %lf  %d %d %d  %lf %lf",
+           &p->dims, &p->mode, &p->ra, &p->rr, &p->rb, &p->dt, &p->b1, &p->b2,
+           &p->d1, &p->d2, &p->sigmode, &p->sigtype, &p->mixtype, &p->sn,
+           &p->sm);
+
+    t = 0;  // read description
+    d = 0;
+    gef = false;
+    do {
+      if (buf[t] == '/') gef = true;
+      if (d < DESCSIZE - 2 && gef && buf[t] != '\r' && buf[t] != '\n')
+        desc[d++] = buf[t];
+    } while (buf[t++] != '\0');
+    desc[d] = '\0';
+    strcpy(p->desc, desc);
+
+    l++;
+  }
+
+  fclose(file);
+  return l;
+}
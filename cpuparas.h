@@ -0,0 +1,27 @@
+/*
+        SmoothLife
+
+        the parameter lines of the config file, read the same way by
+        main.cpp and the headless CPU engine
+*/
+
+#ifndef CPUPARAS_H
+#define CPUPARAS_H
+
+const int DESCSIZE = 64;
+struct parameterlist  // list with all parameter lines from the config file
+{
+  int dims, mode;
+  double ra, rr, rb, dt;
+  double b1, d1, b2, d2;
+  int sigmode, sigtype, mixtype;
+  double sn, sm;
+  char desc[DESCSIZE];  // description text (from the first '/' on, without
+                        // the line end)
+};
+
+// read all paras from a config file into list, returns n paras read or -1
+//
+int read_paralist(const char *fname, struct parameterlist *list, int max);
+
+#endif
@@ -0,0 +1,311 @@
+/*
+        SmoothLife
+
+        snm transfer function for the CPU engine, see cpusnm.h
+
+        fast_exp, fast_atan and fast_sin replace the libm calls so the block
+        loops vectorize, their errors against double precision libm are
+
+        fast_exp	relative error < 3e-7 (argument clamped to -87..88)
+        fast_atan	absolute error < 2e-7
+        fast_sin	absolute error < 3e-7 for |x| < 4 (the snm arguments)
+
+        which is below what the float shaders get on the GPU, the result of
+        one snm call differs from snm*D.frag by less than 1e-5 for all paras
+        in SmoothLifeConfig.txt.
+*/
+
+#include "cpusnm.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "cpulife.h"
+
+static const float PIF = 6.283185307f;  // circle constant as in the shaders
+
+// exp(x) = 2^n * e^f, |f| <= ln2/2, f = x-n*ln2 with ln2 split in two
+// parts to keep f exact, e^f by a Taylor polynomial
+//
+static inline float fast_exp(float x) {
+  if (x < -87.0f) x = -87.0f;
+  if (x > 88.0f) x = 88.0f;
+
+  float n = floorf(x * 1.44269504f + 0.5f);
+  float f = x - n * 0.693145751953125f - n * 1.428606765330187e-6f;
+
+  float p = 1.0f / 720.0f;
+  p = p * f + 1.0f / 120.0f;
+  p = p * f + 1.0f / 24.0f;
+  p = p * f + 1.0f / 6.0f;
+  p = p * f + 0.5f;
+  p = p * f + 1.0f;
+  p = p * f + 1.0f;
+
+  int e = ((int)n + 127) << 23;
+  float s;
+  memcpy(&s, &e, sizeof(s));
+  return p * s;
+}
+
+// atan with the range reduction and polynomial of the Cephes atanf
+//
+static inline float fast_atan(float x) {
+  float a = fabsf(x), y = 0.0f;
+
+  if (a > 2.414213562f) {
+    y = PIF / 4.0f;
+    a = -1.0f / a;
+  } else if (a > 0.414213562f) {
+    y = PIF / 8.0f;
+    a = (a - 1.0f) / (a + 1.0f);
+  }
+
+  float z = a * a;
+  float p = 8.05374449538e-2f;
+  p = p * z - 1.38776856032e-1f;
+  p = p * z + 1.99777106478e-1f;
+  p = p * z - 3.33329491539e-1f;
+  y += p * z * a + a;
+
+  return x < 0.0f ? -y : y;
+}
+
+// sin(x) = (-1)^k sin(r), x = k*PIF/2 + r, |r| <= PIF/4, Taylor polynomial
+//
+static inline float fast_sin(float x) {
+  float k = floorf(x * (2.0f / PIF) + 0.5f);
+  float r = x - k * (PIF / 2.0f);
+  float z = r * r;
+
+  float p = -1.0f / 39916800.0f;
+  p = p * z + 1.0f / 362880.0f;
+  p = p * z - 1.0f / 5040.0f;
+  p = p * z + 1.0f / 120.0f;
+  p = p * z - 1.0f / 6.0f;
+  p = p * z * r + r;
+
+  return ((int)k & 1) ? -p : p;
+}
+
+static inline float fast_cos(float x) { return fast_sin(x + PIF / 4.0f); }
+
+static inline float clamp01(float x) {
+  return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+// step types, same as in main.cpp and the snm shaders
+//
+static void step_hard(const float *__restrict x, const float *__restrict a,
+                      float ea, float *__restrict o, int nb) {
+  for (int i = 0; i < nb; i++) o[i] = x[i] >= a[i] ? 1.0f : 0.0f;
+}
+
+static void step_linear(const float *__restrict x, const float *__restrict a,
+                        float ea, float *__restrict o, int nb) {
+  float r = 1.0f / ea;
+  for (int i = 0; i < nb; i++) o[i] = clamp01((x[i] - a[i]) * r + 0.5f);
+}
+
+static void step_hermite(const float *__restrict x, const float *__restrict a,
+                         float ea, float *__restrict o, int nb) {
+  float r = 1.0f / ea;
+  for (int i = 0; i < nb; i++) {
+    float m = clamp01((x[i] - a[i]) * r + 0.5f);
+    o[i] = m * m * (3.0f - 2.0f * m);
+  }
+}
+
+static void step_sin(const float *__restrict x, const float *__restrict a,
+                     float ea, float *__restrict o, int nb) {
+  float r = 1.0f / ea;
+  for (int i = 0; i < nb; i++) {
+    float t = clamp01((x[i] - a[i]) * r + 0.5f) - 0.5f;
+    o[i] = fast_sin(PIF / 2.0f * t) * 0.5f + 0.5f;
+  }
+}
+
+static void step_smooth(const float *__restrict x, const float *__restrict a,
+                        float ea, float *__restrict o, int nb) {
+  float r = -4.0f / ea;
+  for (int i = 0; i < nb; i++)
+    o[i] = 1.0f / (1.0f + fast_exp((x[i] - a[i]) * r));
+}
+
+static void step_atan(const float *__restrict x, const float *__restrict a,
+                      float ea, float *__restrict o, int nb) {
+  float r = (PIF / 2.0f) / ea;
+  for (int i = 0; i < nb; i++)
+    o[i] = fast_atan((x[i] - a[i]) * r) * (2.0f / PIF) + 0.5f;
+}
+
+static void step_atancos(const float *__restrict x, const float *__restrict a,
+                         float ea, float *__restrict o, int nb) {
+  float r = 1.0f / ea;
+  for (int i = 0; i < nb; i++) {
+    float d = x[i] - a[i];
+    o[i] = (fast_atan(d * r) * (4.0f / PIF) * fast_cos(d * 1.4f) * 1.1f +
+            1.0f) *
+           0.5f;
+  }
+}
+
+static void step_overshoot(const float *__restrict x,
+                           const float *__restrict a, float ea,
+                           float *__restrict o, int nb) {
+  float r = 1.0f / ea;
+  for (int i = 0; i < nb; i++) {
+    float d = (x[i] - a[i]) * r;
+    o[i] = (1.0f / (1.0f + fast_exp(-4.0f * d)) - 0.5f) *
+               (1.0f + fast_exp(-d * d)) +
+           0.5f;
+  }
+}
+
+static const stepfunc steps[8] = {step_hard,   step_linear,  step_hermite,
+                                  step_sin,    step_smooth,  step_atan,
+                                  step_atancos, step_overshoot};
+
+// sigmoid_ab for sigtype 0-7
+//
+static void sigmoid_ab_step(const struct snmfunc *s, const float *x,
+                            const float *a, const float *b, float *o, int nb) {
+  float t1[SNMBLOCK], t2[SNMBLOCK];
+
+  s->stepn(x, a, s->sn, t1, nb);
+  s->stepn(x, b, s->sn, t2, nb);
+  for (int i = 0; i < nb; i++) o[i] = t1[i] * (1.0f - t2[i]);
+}
+
+// sigmoid_ab for sigtype 8 (sg=-0.2) and 9 (sg=0.2)
+//
+static inline void sigmoid_ab_bump(const struct snmfunc *s,
+                                   const float *__restrict x,
+                                   const float *__restrict a,
+                                   const float *__restrict b,
+                                   float *__restrict o, int nb, float sg) {
+  float r = 4.0f / s->sn;
+  for (int i = 0; i < nb; i++) {
+    float c = (x[i] - (a[i] + b[i]) * 0.5f) * 20.0f;
+    o[i] = 1.0f / (1.0f + fast_exp(-(x[i] - a[i]) * r)) * 1.0f /
+           (1.0f + fast_exp((x[i] - b[i]) * r)) *
+           (1.0f + sg * fast_exp(-c * c));
+  }
+}
+
+static void sigmoid_ab_8(const struct snmfunc *s, const float *x,
+                         const float *a, const float *b, float *o, int nb) {
+  sigmoid_ab_bump(s, x, a, b, o, nb, -0.2f);
+}
+
+static void sigmoid_ab_9(const struct snmfunc *s, const float *x,
+                         const float *a, const float *b, float *o, int nb) {
+  sigmoid_ab_bump(s, x, a, b, o, nb, 0.2f);
+}
+
+// o = x*(1-step(m, 0.5)) + y*step(m, 0.5)
+//
+static void sigmoid_mix(const struct snmfunc *s, const float *__restrict x,
+                        const float *__restrict y, const float *__restrict m,
+                        float *__restrict o, int nb) {
+  float t[SNMBLOCK];
+
+  s->stepm(m, s->chalf, s->sm, t, nb);
+  for (int i = 0; i < nb; i++) o[i] = x[i] * (1.0f - t[i]) + y[i] * t[i];
+}
+
+// the four sigmode constructions
+//
+static void sigmode_1(const struct snmfunc *s, const float *n, const float *m,
+                      float *f, int nb) {
+  float t1[SNMBLOCK], t2[SNMBLOCK];
+
+  s->sigmoid_ab(s, n, s->cb1, s->cb2, t1, nb);
+  s->sigmoid_ab(s, n, s->cd1, s->cd2, t2, nb);
+  for (int i = 0; i < nb; i++) f[i] = t1[i] * (1.0f - m[i]) + t2[i] * m[i];
+}
+
+static void sigmode_2(const struct snmfunc *s, const float *n, const float *m,
+                      float *f, int nb) {
+  float t1[SNMBLOCK], t2[SNMBLOCK];
+
+  s->sigmoid_ab(s, n, s->cb1, s->cb2, t1, nb);
+  s->sigmoid_ab(s, n, s->cd1, s->cd2, t2, nb);
+  sigmoid_mix(s, t1, t2, m, f, nb);
+}
+
+static void sigmode_3(const struct snmfunc *s, const float *n, const float *m,
+                      float *f, int nb) {
+  float a[SNMBLOCK], b[SNMBLOCK];
+
+  for (int i = 0; i < nb; i++) {
+    a[i] = s->cb1[i] * (1.0f - m[i]) + s->cd1[i] * m[i];
+    b[i] = s->cb2[i] * (1.0f - m[i]) + s->cd2[i] * m[i];
+  }
+  s->sigmoid_ab(s, n, a, b, f, nb);
+}
+
+static void sigmode_4(const struct snmfunc *s, const float *n, const float *m,
+                      float *f, int nb) {
+  float a[SNMBLOCK], b[SNMBLOCK];
+
+  sigmoid_mix(s, s->cb1, s->cd1, m, a, nb);
+  sigmoid_mix(s, s->cb2, s->cd2, m, b, nb);
+  s->sigmoid_ab(s, n, a, b, f, nb);
+}
+
+void snm_prepare(struct snmfunc *s, const struct parameterlist *p) {
+  s->sigmode = p->sigmode;
+  s->sigtype = p->sigtype;
+  s->mixtype = p->mixtype;
+  s->mode = p->mode;
+  s->sn = (float)p->sn;
+  s->sm = (float)p->sm;
+  s->dt = (float)p->dt;
+
+  for (int i = 0; i < SNMBLOCK; i++) {
+    s->cb1[i] = (float)p->b1;
+    s->cb2[i] = (float)p->b2;
+    s->cd1[i] = (float)p->d1;
+    s->cd2[i] = (float)p->d2;
+    s->chalf[i] = 0.5f;
+  }
+
+  s->stepn = steps[p->sigtype >= 0 && p->sigtype < 8 ? p->sigtype : 0];
+  s->stepm = steps[p->mixtype >= 0 && p->mixtype < 8 ? p->mixtype : 0];
+
+  if (p->sigtype == 8)
+    s->sigmoid_ab = sigmoid_ab_8;
+  else if (p->sigtype == 9)
+    s->sigmoid_ab = sigmoid_ab_9;
+  else
+    s->sigmoid_ab = sigmoid_ab_step;
+
+  if (p->sigmode == 1)
+    s->sigmode_fn = sigmode_1;
+  else if (p->sigmode == 2)
+    s->sigmode_fn = sigmode_2;
+  else if (p->sigmode == 3)
+    s->sigmode_fn = sigmode_3;
+  else  // sigmode==4
+    s->sigmode_fn = sigmode_4;
+}
+
+void snm_block(const struct snmfunc *s, const float *__restrict an,
+               const float *__restrict am, float *__restrict aa, int nb) {
+  float f[SNMBLOCK];
+  float dt = s->dt;
+
+  s->sigmode_fn(s, an, am, f, nb);
+
+  if (s->mode == 1)
+    for (int i = 0; i < nb; i++) f[i] = aa[i] + dt * (2.0f * f[i] - 1.0f);
+  else if (s->mode == 2)
+    for (int i = 0; i < nb; i++) f[i] = aa[i] + dt * (f[i] - aa[i]);
+  else if (s->mode == 3)
+    for (int i = 0; i < nb; i++) f[i] = am[i] + dt * (2.0f * f[i] - 1.0f);
+  else if (s->mode == 4)
+    for (int i = 0; i < nb; i++) f[i] = am[i] + dt * (f[i] - am[i]);
+
+  for (int i = 0; i < nb; i++) aa[i] = clamp01(f[i]);
+}
@@ -0,0 +1,52 @@
+/*
+        SmoothLife
+
+        snm transfer function for the CPU engine, the same as snm*D.frag
+
+        The sigmoid variants are picked once per step by snm_prepare, the
+        cells are then done in blocks of SNMBLOCK with plain float loops and
+        polynomial exp/atan/sin that the compiler vectorizes.
+*/
+
+#ifndef CPUSNM_H
+#define CPUSNM_H
+
+struct parameterlist;
+
+const int SNMBLOCK = 64;  // cells done together by the block functions
+
+struct snmfunc;
+
+// step function of one type on nb <= SNMBLOCK cells, o=func(x, a, ea)
+//
+typedef void (*stepfunc)(const float *x, const float *a, float ea, float *o,
+                         int nb);
+
+struct snmfunc {
+  int sigmode, sigtype, mixtype, mode;
+  float sn, sm, dt;
+
+  stepfunc stepn;  // step function for sigtype 0-7 in n direction
+  stepfunc stepm;  // step function for mixtype 0-7 in m direction
+
+  // sigmoid_ab and the sigmode construction picked for the paras
+  void (*sigmoid_ab)(const struct snmfunc *s, const float *x, const float *a,
+                     const float *b, float *o, int nb);
+  void (*sigmode_fn)(const struct snmfunc *s, const float *n, const float *m,
+                     float *f, int nb);
+
+  // b1, b2, d1, d2 and 0.5 as constant blocks
+  float cb1[SNMBLOCK], cb2[SNMBLOCK], cd1[SNMBLOCK], cd2[SNMBLOCK];
+  float chalf[SNMBLOCK];
+};
+
+// pick the functions for paras p, once per step
+//
+void snm_prepare(struct snmfunc *s, const struct parameterlist *p);
+
+// apply snm to nb <= SNMBLOCK cells, aa holds the old value and gets the new
+//
+void snm_block(const struct snmfunc *s, const float *an, const float *am,
+               float *aa, int nb);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+        SmoothLife
+
+        small thread pool for the CPU engine, see cputhreads.h
+*/
+
+#include "cputhreads.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+static pthread_t threads[MAXTHREADS];
+static int nthreads = 1;  // running threads including the caller
+static int nstarted = 0;  // worker threads started
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cv_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t cv_done = PTHREAD_COND_INITIALIZER;
+
+static void (*job_fn)(void *ctx, int task, int thread);
+static void *job_ctx;
+static int job_ntasks;
+static int job_next;   // next task to take, atomic
+static int job_gen;    // incremented for every new job
+static int job_busy;   // workers still working on the current job
+static int job_width;  // n workers taking part in the current job
+static int start_gen[MAXTHREADS];  // job_gen when the worker was started
+
+// take tasks until there are none left
+//
+static void run_tasks(int thread) {
+  for (;;) {
+    int t = __atomic_fetch_add(&job_next, 1, __ATOMIC_RELAXED);
+    if (t >= job_ntasks) break;
+    job_fn(job_ctx, t, thread);
+  }
+}
+
+static void *worker(void *arg) {
+  int id = (int)(long)arg;
+  int seen = start_gen[id];
+
+  for (;;) {
+    pthread_mutex_lock(&mtx);
+    while (job_gen == seen) pthread_cond_wait(&cv_work, &mtx);
+    seen = job_gen;
+    bool take = id < job_width;
+    pthread_mutex_unlock(&mtx);
+
+    if (take) run_tasks(id);
+
+    pthread_mutex_lock(&mtx);
+    if (--job_busy == 0) pthread_cond_signal(&cv_done);
+    pthread_mutex_unlock(&mtx);
+  }
+  return 0;
+}
+
+void cputhreads_init(int n) {
+  if (n <= 0) n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1) n = 1;
+  if (n > MAXTHREADS) n = MAXTHREADS;
+
+  // workers are never stopped, surplus ones just sit out the jobs
+  while (nstarted < n - 1) {
+    start_gen[nstarted + 1] = job_gen;
+    if (pthread_create(&threads[nstarted], 0, worker,
+                       (void *)(long)(nstarted + 1)))
+      break;
+    pthread_detach(threads[nstarted]);
+    nstarted++;
+  }
+  nthreads = n <= nstarted + 1 ? n : nstarted + 1;
+}
+
+int cputhreads_count(void) { return nthreads; }
+
+void parallel_for(int ntasks, void (*fn)(void *ctx, int task, int thread),
+                  void *ctx) {
+  if (nthreads == 1 || ntasks <= 1) {
+    for (int t = 0; t < ntasks; t++) fn(ctx, t, 0);
+    return;
+  }
+
+  pthread_mutex_lock(&mtx);
+  job_fn = fn;
+  job_ctx = ctx;
+  job_ntasks = ntasks;
+  job_next = 0;
+  job_width = nthreads;
+  job_busy = nstarted;
+  job_gen++;
+  pthread_cond_broadcast(&cv_work);
+  pthread_mutex_unlock(&mtx);
+
+  run_tasks(0);
+
+  pthread_mutex_lock(&mtx);
+  while (job_busy > 0) pthread_cond_wait(&cv_done, &mtx);
+  pthread_mutex_unlock(&mtx);
+}
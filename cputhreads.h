@@ -0,0 +1,28 @@
+/*
+        SmoothLife
+
+        small thread pool for the CPU engine
+*/
+
+#ifndef CPUTHREADS_H
+#define CPUTHREADS_H
+
+const int MAXTHREADS = 256;
+
+// start the worker threads, n=0 means one per core, can be called again to
+// change the number of threads (without it everything runs in the caller)
+//
+void cputhreads_init(int n);
+
+// number of threads including the calling one
+//
+int cputhreads_count(void);
+
+// call fn(ctx, task, thread) for all tasks 0 <= task < ntasks, spread over
+// all threads, returns when all tasks are done (not reentrant, don't call it
+// from inside fn), thread < cputhreads_count() can index per thread scratch
+//
+void parallel_for(int ntasks, void (*fn)(void *ctx, int task, int thread),
+                  void *ctx);
+
+#endif
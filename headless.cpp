@@ -0,0 +1,742 @@
+/*
+        SmoothLife
+
+        command line driver for the headless CPU engine
+
+        -c file		config file (default SmoothLifeConfig.txt)
+        -p n		paras number n from the config file (default 0)
+        -d n		n dimensions 1, 2 or 3 (default from the paras)
+        -n n		buffer size NN (default 1024 in 1D, 512 in 2D, 64 in 3D)
+        -s n		n time steps (default 100)
+        -r n		random seed for the blobs (default time)
+        -t n		n threads (default one per core)
+        -o file		save buffer as raw floats after the last step
+        -e list		ensemble of the paras numbers in list (like 0,3,5-9), all
+        		stepped together, member i is seeded with seed+i
+        -w dir		sweep: run every paras (or those of -e and -d) on its own
+        		dims for -s steps with the same seed (default 1), the
+        		metrics and a thumbnail of each go to dir
+        -b file		benchmark: fixed seed (default 1) runs of every size of
+        		keys 5-9 in main.cpp with the first paras of each dims
+        		and of the first paras of each mode at the default size
+        		(or of -e, -d, at most -n and -s steps), step times,
+        		stages and peak memory go to file as JSON
+        -B file		compare the benchmark with the baseline file (a -b
+        		output), slower medians are regressions (exit code 2)
+        -v		print mean value after every step
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "cpuensemble.h"
+#include "cpulife.h"
+#include "cputhreads.h"
+
+struct parameterlist paralist[1000];  // parameter list, max 1000 entries
+
+// wall clock in seconds
+//
+double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void usage(void) {
+  fprintf(stderr,
+          "usage: smoothlife_headless [-c config] [-p paras] [-d dims] "
+          "[-n size] [-s steps] [-r seed] [-t threads] [-o file.raw] "
+          "[-e list] [-w dir] [-b file.json] [-B base.json] [-v]\n");
+}
+
+// paras numbers of list (n,n,a-b,...) into e, returns how many or -1
+//
+int parselist(const char *list, int *e, int max) {
+  int n = 0;
+
+  while (*list) {
+    char *end;
+    int a = (int)strtol(list, &end, 10), b = a;
+    if (end == list) return -1;
+    if (*end == '-') {
+      list = end + 1;
+      b = (int)strtol(list, &end, 10);
+      if (end == list || b < a) return -1;
+    }
+    for (; a <= b; a++) {
+      if (n >= max) return -1;
+      e[n++] = a;
+    }
+    if (*end == ',')
+      end++;
+    else if (*end)
+      return -1;
+    list = end;
+  }
+  return n;
+}
+
+// the ensemble mode (-e), returns the exit code
+//
+int ensemble(const int *member, int K, int dims, int size, int steps,
+             unsigned seed, const char *outname, int verbose) {
+  struct parameterlist *p =
+      (struct parameterlist *)calloc(K, sizeof(struct parameterlist));
+  struct cpuensemble e;
+  int t, b;
+
+  if (p == 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (b = 0; b < K; b++) p[b] = paralist[member[b]];
+  bool ok = cpuensemble_create(&e, dims, size, size, size, K, p);
+  free(p);
+  if (!ok) {
+    fprintf(stderr, "couldn't create buffers (size must be a power of 2)\n");
+    return 1;
+  }
+  cpuensemble_inita(&e, seed);
+
+  printf("ensemble of %d members, %d kernels\n", K, e.nkern);
+  for (b = 0; b < K; b++)
+    printf("%d: paras %d %s  kflr=%f kfld=%f\n", b, member[b],
+           paralist[member[b]].desc, e.kflr[e.kern[b]], e.kfld[e.kern[b]]);
+  printf("dims %d  size %d %d %d  seed %u  threads %d\n", dims, e.NX, e.NY,
+         e.NZ, seed, cputhreads_count());
+
+  double tim = seconds();
+  for (t = 0; t < steps; t++) {
+    cpuensemble_step(&e);
+    if (verbose) {
+      printf("%d", t + 1);
+      for (b = 0; b < K; b++) printf(" %f", cpuensemble_mean(&e, b));
+      printf("\n");
+    }
+  }
+  double tima = seconds();
+
+  printf("%d steps  %.3f ms/step  %.1f member steps/s\n", steps,
+         steps ? (tima - tim) * 1000.0 / steps : 0.0,
+         tima > tim ? steps * K / (tima - tim) : 0.0);
+  for (b = 0; b < K; b++) printf("%d: mean %f\n", b, cpuensemble_mean(&e, b));
+
+  if (outname) {
+    FILE *file = fopen(outname, "wb");
+    if (file == 0) {
+      fprintf(stderr, "couldn't open %s\n", outname);
+      cpuensemble_free(&e);
+      return 1;
+    }
+    fwrite(e.aa, sizeof(float), (size_t)K * e.NX * e.NY * e.NZ, file);
+    fclose(file);
+  }
+
+  cpuensemble_free(&e);
+  return 0;
+}
+
+const long SWEEPCELLS = 1L << 24;  // max cells of the paras run together
+const int THUMB = 256;              // max thumbnail width and height
+
+// metrics of one paras after a sweep
+//
+struct sweepresult {
+  bool run;  // in the sweep
+  int dims, size;
+  double mean, sd, min, max;
+  double alive;    // fraction of cells > 0.5
+  long nonfinite;  // n cells that are nan or inf
+  double ms;       // its share of the ms per step
+  unsigned char *thumb;
+  int tw, th;  // thumbnail size
+};
+
+// box filtered gray image of an nx*ny slice (values 0..1), fx*fy cells per
+// pixel
+//
+void thumbrows(const float *a, int nx, int ny, int fx, int fy,
+               unsigned char *img) {
+  int tw = nx / fx, th = ny / fy;
+
+  for (int y = 0; y < th; y++)
+    for (int x = 0; x < tw; x++) {
+      double s = 0.0;
+      for (int v = 0; v < fy; v++)
+        for (int u = 0; u < fx; u++)
+          s += a[(long)(y * fy + v) * nx + x * fx + u];
+      s /= fx * fy;
+      img[y * tw + x] = (unsigned char)(s < 0.0 ? 0 : s > 1.0 ? 255 : s * 255);
+    }
+}
+
+bool writepgm(const char *fname, const unsigned char *img, int w, int h) {
+  FILE *file = fopen(fname, "wb");
+  if (file == 0) return false;
+  fprintf(file, "P5\n%d %d\n255\n", w, h);
+  fwrite(img, 1, (size_t)w * h, file);
+  fclose(file);
+  return true;
+}
+
+// run paras member[0..K-1] of one dims as ensembles of up to SWEEPCELLS
+// cells, each starts with the blobs of seed, the results go to res[paras]
+//
+bool sweepdims(const int *member, int K, int dims, int size, int steps,
+               unsigned seed, struct sweepresult *res) {
+  long n = (long)size * (dims > 1 ? size : 1) * (dims > 2 ? size : 1);
+  int chunk = SWEEPCELLS / n > 0 ? (int)(SWEEPCELLS / n) : 1;
+  struct parameterlist *p =
+      (struct parameterlist *)calloc(chunk, sizeof(struct parameterlist));
+  int f = size > THUMB ? size / THUMB : 1;
+  int tw = size / f;
+  int th = dims == 1 ? (steps < THUMB ? steps : THUMB) : tw;
+  int b, t;
+
+  if (p == 0) return false;
+  if (th < 1) th = 1;
+
+  for (int c0 = 0; c0 < K; c0 += chunk) {
+    int nb = K - c0 < chunk ? K - c0 : chunk;
+    struct cpuensemble e;
+
+    for (b = 0; b < nb; b++) p[b] = paralist[member[c0 + b]];
+    if (!cpuensemble_create(&e, dims, size, size, size, nb, p)) {
+      free(p);
+      return false;
+    }
+    for (b = 0; b < nb; b++) {
+      struct sweepresult &r = res[member[c0 + b]];
+      cpulife_blobs(e.aa + b * n, e.NX, e.NY, e.NZ, e.p[b].ra, seed);
+      r.thumb = (unsigned char *)calloc((size_t)tw * th, 1);
+      if (r.thumb == 0) {
+        cpuensemble_free(&e);
+        free(p);
+        return false;
+      }
+      r.tw = tw;
+      r.th = th;
+    }
+
+    double tim = seconds();
+    for (t = 0; t < steps; t++) {
+      cpuensemble_step(&e);
+      // 1D thumbnails are the last th steps, the oldest on top
+      if (dims == 1 && t >= steps - th)
+        for (b = 0; b < nb; b++)
+          thumbrows(e.aa + b * n, size, 1, f, 1,
+                    res[member[c0 + b]].thumb + (t - (steps - th)) * tw);
+    }
+    double ms = steps ? (seconds() - tim) * 1000.0 / steps / nb : 0.0;
+
+    for (b = 0; b < nb; b++) {
+      struct sweepresult &r = res[member[c0 + b]];
+      const float *a = e.aa + b * n;
+      double s = 0.0, s2 = 0.0;
+      long alive = 0;
+      r.dims = dims;
+      r.size = size;
+      r.min = 1e30;
+      r.max = -1e30;
+      r.nonfinite = 0;
+      r.ms = ms;
+      for (long i = 0; i < n; i++) {
+        if (!isfinite(a[i])) {
+          r.nonfinite++;
+          continue;
+        }
+        s += a[i];
+        s2 += (double)a[i] * a[i];
+        if (a[i] < r.min) r.min = a[i];
+        if (a[i] > r.max) r.max = a[i];
+        if (a[i] > 0.5f) alive++;
+      }
+      r.mean = s / n;
+      r.sd = sqrt(s2 / n - r.mean * r.mean > 0 ? s2 / n - r.mean * r.mean : 0);
+      r.alive = (double)alive / n;
+      if (dims > 1)  // 3D shows the middle slice
+        thumbrows(a + (long)(e.NZ / 2) * size * size, size, size, f, f,
+                  r.thumb);
+    }
+
+    printf("%dD %d-%d of %d  %d steps  %.3f ms/step/paras\n", dims, c0 + 1,
+           c0 + nb, K, steps, ms);
+    fflush(stdout);
+    cpuensemble_free(&e);
+  }
+
+  free(p);
+  return true;
+}
+
+// the sweep mode (-w), paras member[0..K-1] (all if K=0) of dims (all if 0)
+// on their own dims, size 0 is 1024/512/64 in 1D/2D/3D, dir/metrics.txt gets
+// a line per paras and dir/paras_NNN.pgm its thumbnail, returns the exit code
+//
+int sweep(const int *member, int K, int nparas, int dims, int size, int steps,
+          unsigned seed, const char *dir) {
+  static int list[1000];
+  static struct sweepresult res[1000];
+  int d, t, n;
+  char fname[1024];
+
+  mkdir(dir, 0777);
+  snprintf(fname, sizeof(fname), "%s/metrics.txt", dir);
+  FILE *file = fopen(fname, "w");
+  if (file == 0) {
+    fprintf(stderr, "couldn't open %s\n", fname);
+    return 1;
+  }
+
+  for (t = 0; t < (K ? K : nparas); t++) {
+    int q = K ? member[t] : t;
+    res[q].run = !dims || paralist[q].dims == dims;
+  }
+
+  double tim = seconds();
+  for (d = 1; d <= 3; d++) {
+    n = 0;
+    for (t = 0; t < nparas; t++)
+      if (res[t].run && paralist[t].dims == d) list[n++] = t;
+    if (n == 0) continue;
+    int sz = size ? size : d == 1 ? 1024 : d == 2 ? 512 : 64;
+    if (!sweepdims(list, n, d, sz, steps, seed, res)) {
+      fprintf(stderr, "couldn't create buffers (size must be a power of 2)\n");
+      fclose(file);
+      return 1;
+    }
+  }
+
+  fprintf(file, "# seed %u  steps %d  threads %d  %.1f s\n", seed, steps,
+          cputhreads_count(), seconds() - tim);
+  fprintf(file,
+          "# paras\tdims\tsize\tmean\tsd\tmin\tmax\talive\tnonfinite\t"
+          "ms/step\tdesc\n");
+  for (t = 0; t < nparas; t++) {
+    struct sweepresult &r = res[t];
+    if (!r.run) continue;
+    fprintf(file, "%d\t%d\t%d\t%.6f\t%.6f\t%.6f\t%.6f\t%.6f\t%ld\t%.3f\t%s\n",
+            t, r.dims, r.size, r.mean, r.sd, r.min, r.max, r.alive,
+            r.nonfinite, r.ms, paralist[t].desc);
+    snprintf(fname, sizeof(fname), "%s/paras_%03d.pgm", dir, t);
+    if (!writepgm(fname, r.thumb, r.tw, r.th))
+      fprintf(stderr, "couldn't write %s\n", fname);
+    free(r.thumb);
+    r.thumb = 0;
+  }
+  fclose(file);
+
+  printf("sweep done in %.1f s, results in %s\n", seconds() - tim, dir);
+  return 0;
+}
+
+const long BENCHCELLS = 1L << 24;  // cell steps of a scenario, about
+const int BENCHMIN = 5;            // min steps of a scenario
+const double BENCHTOL = 0.10;      // a median slower than the baseline by
+                                   // more is a regression
+const int BENCHMAX = 64;           // max scenarios
+
+// sizes of keys 5-9 in main.cpp
+const int benchsizes[3][5] = {{512, 1024, 2048, 4096, 8192},
+                              {128, 256, 512, 1024, 2048},
+                              {32, 64, 128, 256, 512}};
+
+const char *stagename[STAGES] = {"fft", "kernelmul", "ifft", "snm"};
+
+// one benchmark scenario
+//
+struct benchresult {
+  char name[32];  // dims, size and paras like 2D-512-p3
+  int dims, size, paras, steps;
+  double median, p99, mean;  // ms per step
+  double stage[STAGES];      // ms per step
+  double peakmb;             // peak resident memory
+  double checksum;           // mean of the buffer after the steps
+  bool ok;                   // buffers could be made
+};
+
+// reset the peak resident memory of the process (Linux 4.0), false if that
+// isn't possible
+//
+bool peakreset(void) {
+  FILE *file = fopen("/proc/self/clear_refs", "w");
+  if (file == 0) return false;
+  bool ok = fputs("5", file) >= 0;
+  return fclose(file) == 0 && ok;
+}
+
+// peak resident memory in MB (VmHWM), -1 if unknown
+//
+double peakmb(void) {
+  char buf[256];
+  long kb = -1;
+  FILE *file = fopen("/proc/self/status", "r");
+  if (file == 0) return -1.0;
+  while (fgets(buf, sizeof(buf), file))
+    if (sscanf(buf, "VmHWM: %ld kB", &kb) == 1) break;
+  fclose(file);
+  return kb < 0 ? -1.0 : kb / 1024.0;
+}
+
+// run paras number paras with seed on a dims dimensional grid of size, one
+// warm up step, then at least BENCHMIN and at most maxsteps steps
+//
+void benchrun(struct benchresult *r, int dims, int size, int paras,
+              int maxsteps, unsigned seed) {
+  long cells = (long)size * (dims > 1 ? size : 1) * (dims > 2 ? size : 1);
+  struct cpulife sl;
+  int t;
+
+  memset(r, 0, sizeof(*r));
+  snprintf(r->name, sizeof(r->name), "%dD-%d-p%d", dims, size, paras);
+  r->dims = dims;
+  r->size = size;
+  r->paras = paras;
+  r->steps =
+      BENCHCELLS / cells > maxsteps ? maxsteps : (int)(BENCHCELLS / cells);
+  if (r->steps < BENCHMIN) r->steps = BENCHMIN;
+
+  peakreset();
+  double *ms = (double *)calloc(r->steps, sizeof(double));
+  if (ms == 0 ||
+      !cpulife_create(&sl, dims, size, size, size, &paralist[paras])) {
+    free(ms);
+    return;
+  }
+  cpulife_inita(&sl, seed);
+  cpulife_step(&sl);
+  memset(sl.stagesec, 0, sizeof(sl.stagesec));
+
+  for (t = 0; t < r->steps; t++) {
+    double tim = seconds();
+    cpulife_step(&sl);
+    ms[t] = (seconds() - tim) * 1000.0;
+    r->mean += ms[t] / r->steps;
+  }
+  for (t = 0; t < STAGES; t++)
+    r->stage[t] = sl.stagesec[t] * 1000.0 / r->steps;
+  r->checksum = cpulife_mean(&sl);
+  r->peakmb = peakmb();
+  cpulife_free(&sl);
+
+  std::sort(ms, ms + r->steps);
+  int h = r->steps / 2;
+  r->median = r->steps % 2 ? ms[h] : 0.5 * (ms[h - 1] + ms[h]);
+  r->p99 = ms[(int)ceil(0.99 * r->steps) - 1];  // nearest rank
+  r->ok = true;
+  free(ms);
+}
+
+// benchmark results as JSON, one scenario per line (loadbaseline reads them)
+//
+bool writebench(const char *fname, const struct benchresult *res, int n,
+                unsigned seed, const char *config, bool peakok) {
+  FILE *file = fopen(fname, "w");
+  if (file == 0) return false;
+
+  fprintf(file, "{\n  \"suite\": \"smoothlife_headless\",\n");
+  fprintf(file, "  \"config\": \"%s\",\n  \"seed\": %u,\n", config, seed);
+  fprintf(file, "  \"threads\": %d,\n  \"peak_per_scenario\": %s,\n",
+          cputhreads_count(), peakok ? "true" : "false");
+  fprintf(file, "  \"scenarios\": [\n");
+  for (int i = 0; i < n; i++) {
+    const struct benchresult &r = res[i];
+    fprintf(file,
+            "    {\"name\": \"%s\", \"dims\": %d, \"size\": %d, \"paras\": %d, "
+            "\"desc\": \"",
+            r.name, r.dims, r.size, r.paras);
+    for (const char *c = paralist[r.paras].desc; *c; c++)
+      if (*c != '"' && *c != '\\' && (unsigned char)*c >= 32) fputc(*c, file);
+    if (r.ok) {
+      fprintf(file,
+              "\", \"steps\": %d, \"median_ms\": %.4f, \"p99_ms\": %.4f, "
+              "\"mean_ms\": %.4f, \"steps_per_s\": %.2f, \"stages_ms\": {",
+              r.steps, r.median, r.p99, r.mean,
+              r.mean > 0 ? 1000.0 / r.mean : 0.0);
+      for (int s = 0; s < STAGES; s++)
+        fprintf(file, "%s\"%s\": %.4f", s ? ", " : "", stagename[s],
+                r.stage[s]);
+      fprintf(file, "}, \"peak_mb\": %.1f, \"checksum\": %.9f}", r.peakmb,
+              r.checksum);
+    } else
+      fprintf(file, "\", \"error\": \"out of memory\"}");
+    fprintf(file, "%s\n", i + 1 < n ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+// name, median and checksum of the scenarios of a -b output file into base,
+// returns how many or -1
+//
+int loadbaseline(const char *fname, struct benchresult *base, int max) {
+  char buf[1024];
+  int n = 0;
+  FILE *file = fopen(fname, "r");
+  if (file == 0) return -1;
+
+  while (n < max && fgets(buf, sizeof(buf), file)) {
+    const char *a = strstr(buf, "\"name\": \"");
+    const char *m = strstr(buf, "\"median_ms\": ");
+    const char *c = strstr(buf, "\"checksum\": ");
+    if (a == 0 || m == 0 || c == 0) continue;
+    memset(&base[n], 0, sizeof(base[n]));
+    a += 9;
+    int l = 0;
+    while (a[l] && a[l] != '"' && l < (int)sizeof(base[n].name) - 1) l++;
+    memcpy(base[n].name, a, l);
+    base[n].median = strtod(m + 13, 0);
+    base[n].checksum = strtod(c + 12, 0);
+    base[n].ok = true;
+    n++;
+  }
+  fclose(file);
+  return n;
+}
+
+// the benchmark mode (-b, -B): paras member[0..K-1] (the first of each mode
+// of each dims if K=0) at the default size, the first of them at every size
+// up to maxsize (all if 0), only dims if not 0, returns the exit code
+//
+int bench(const int *member, int K, int nparas, int dims, int maxsize,
+          int maxsteps, unsigned seed, const char *config, const char *outname,
+          const char *basename) {
+  static struct benchresult res[BENCHMAX], base[BENCHMAX];
+  int n = 0, nb = 0, d, i, j;
+
+  if (basename) {
+    nb = loadbaseline(basename, base, BENCHMAX);
+    if (nb < 0) {
+      fprintf(stderr, "couldn't read baseline %s\n", basename);
+      return 1;
+    }
+  }
+  bool peakok = peakreset();
+
+  double tim = seconds();
+  for (d = 1; d <= 3; d++) {
+    if (dims && d != dims) continue;
+
+    int list[16], nl = 0;
+    for (i = 0; i < (K ? K : nparas) && nl < 16; i++) {
+      int q = K ? member[i] : i;
+      if (paralist[q].dims != d) continue;
+      for (j = 0; j < nl; j++)
+        if (K == 0 && paralist[list[j]].mode == paralist[q].mode) break;
+      if (j == nl) list[nl++] = q;
+    }
+    if (nl == 0) continue;
+
+    int defsize = d == 1 ? 1024 : d == 2 ? 512 : 64;
+    for (i = 0; i < 5 && n < BENCHMAX; i++) {
+      int sz = benchsizes[d - 1][i];
+      if (maxsize && sz > maxsize) continue;
+      benchrun(&res[n], d, sz, list[0], maxsteps, seed);
+      printf("%-14s %4d steps  median %9.3f ms  p99 %9.3f ms  %8.1f MB\n",
+             res[n].name, res[n].steps, res[n].median, res[n].p99,
+             res[n].peakmb);
+      fflush(stdout);
+      n++;
+    }
+    if (maxsize && defsize > maxsize) defsize = benchsizes[d - 1][0];
+    for (j = 1; j < nl && n < BENCHMAX; j++) {
+      benchrun(&res[n], d, defsize, list[j], maxsteps, seed);
+      printf("%-14s %4d steps  median %9.3f ms  p99 %9.3f ms  %8.1f MB\n",
+             res[n].name, res[n].steps, res[n].median, res[n].p99,
+             res[n].peakmb);
+      fflush(stdout);
+      n++;
+    }
+  }
+  printf("benchmark done in %.1f s\n", seconds() - tim);
+
+  if (outname && !writebench(outname, res, n, seed, config, peakok)) {
+    fprintf(stderr, "couldn't write %s\n", outname);
+    return 1;
+  }
+
+  if (basename == 0) return 0;
+
+  int regressions = 0;
+  printf("\n%-14s %12s %12s %8s\n", "scenario", "base ms", "ms", "ratio");
+  for (i = 0; i < n; i++) {
+    const struct benchresult &r = res[i];
+    for (j = 0; j < nb; j++)
+      if (strcmp(base[j].name, r.name) == 0) break;
+    if (j == nb || !r.ok) {
+      printf("%-14s %12s %12.3f\n", r.name, "-", r.median);
+      continue;
+    }
+    double ratio = base[j].median > 0 ? r.median / base[j].median : 1.0;
+    bool slow = ratio > 1.0 + BENCHTOL;
+    bool changed = fabs(r.checksum - base[j].checksum) >
+                   1e-6 * (fabs(base[j].checksum) + 1e-6);
+    printf("%-14s %12.3f %12.3f %8.3f%s%s\n", r.name, base[j].median, r.median,
+           ratio, slow ? "  REGRESSION" : "",
+           changed ? "  result changed" : "");
+    if (slow) regressions++;
+  }
+  printf("%d regressions (more than %.0f%% slower than %s)\n", regressions,
+         BENCHTOL * 100.0, basename);
+  return regressions ? 2 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *config = "SmoothLifeConfig.txt";
+  const char *outname = 0;
+  const char *enslist = 0;
+  const char *sweepdir = 0;
+  const char *benchout = 0;
+  const char *benchbase = 0;
+  bool seedset = false;
+  int curparas = 0, dims = 0, size = 0, steps = 100, verbose = 0;
+  int nthreads = 0;
+  unsigned seed = (unsigned)time(0);
+  int nparas, t;
+
+  for (t = 1; t < argc; t++) {
+    if (argv[t][0] != '-' || argv[t][1] == '\0' || argv[t][2] != '\0') {
+      usage();
+      return 1;
+    }
+    char o = argv[t][1];
+    if (o == 'v') {
+      verbose = 1;
+      continue;
+    }
+    if (t + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    const char *a = argv[++t];
+    if (o == 'c')
+      config = a;
+    else if (o == 'p')
+      curparas = atoi(a);
+    else if (o == 'd')
+      dims = atoi(a);
+    else if (o == 'n')
+      size = atoi(a);
+    else if (o == 's')
+      steps = atoi(a);
+    else if (o == 'r') {
+      seed = (unsigned)strtoul(a, 0, 10);
+      seedset = true;
+    }
+    else if (o == 't')
+      nthreads = atoi(a);
+    else if (o == 'o')
+      outname = a;
+    else if (o == 'e')
+      enslist = a;
+    else if (o == 'w')
+      sweepdir = a;
+    else if (o == 'b')
+      benchout = a;
+    else if (o == 'B')
+      benchbase = a;
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  nparas = read_paralist(config, paralist, 1000);
+  if (nparas < 0) {
+    fprintf(stderr, "couldn't read config file %s\n", config);
+    return 1;
+  }
+
+  static int member[1000];
+  int K = 0;
+  if (enslist) {
+    K = parselist(enslist, member, 1000);
+    if (K <= 0) {
+      fprintf(stderr, "bad ensemble list %s\n", enslist);
+      return 1;
+    }
+    curparas = member[0];
+    for (t = 0; t < K; t++)
+      if (member[t] < 0 || member[t] >= nparas) curparas = member[t];
+  }
+
+  if (curparas < 0 || curparas >= nparas) {
+    fprintf(stderr, "paras number %d not in config file (%d lines)\n",
+            curparas, nparas);
+    return 1;
+  }
+
+  if (benchout || benchbase) {
+    if (dims < 0 || dims > 3) {
+      fprintf(stderr, "dims must be 1, 2 or 3\n");
+      return 1;
+    }
+    cputhreads_init(nthreads);
+    return bench(member, K, nparas, dims, size, steps, seedset ? seed : 1,
+                 config, benchout, benchbase);
+  }
+
+  if (sweepdir) {
+    if (dims < 0 || dims > 3) {
+      fprintf(stderr, "dims must be 1, 2 or 3\n");
+      return 1;
+    }
+    cputhreads_init(nthreads);
+    return sweep(member, K, nparas, dims, size, steps, seedset ? seed : 1,
+                 sweepdir);
+  }
+
+  if (dims == 0) dims = paralist[curparas].dims;
+  if (dims < 1 || dims > 3) {
+    fprintf(stderr, "dims must be 1, 2 or 3\n");
+    return 1;
+  }
+  if (size == 0) size = dims == 1 ? 1024 : dims == 2 ? 512 : 64;
+
+  cputhreads_init(nthreads);
+
+  if (enslist)
+    return ensemble(member, K, dims, size, steps, seed, outname, verbose);
+
+  struct cpulife sl;
+  if (!cpulife_create(&sl, dims, size, size, size, &paralist[curparas])) {
+    fprintf(stderr, "couldn't create buffers (size must be a power of 2)\n");
+    return 1;
+  }
+  cpulife_inita(&sl, seed);
+
+  printf("paras %d %s\n", curparas, paralist[curparas].desc);
+  printf("dims %d  size %d %d %d  seed %u  threads %d  kflr=%f kfld=%f\n",
+         dims, sl.NX, sl.NY, sl.NZ, seed, cputhreads_count(), sl.kflr,
+         sl.kfld);
+
+  double tim = seconds();
+  for (t = 0; t < steps; t++) {
+    cpulife_step(&sl);
+    if (verbose) printf("%d %f\n", t + 1, cpulife_mean(&sl));
+  }
+  double tima = seconds();
+
+  printf("%d steps  %.3f ms/step  mean %f\n", steps,
+         steps ? (tima - tim) * 1000.0 / steps : 0.0, cpulife_mean(&sl));
+
+  if (outname) {
+    FILE *file = fopen(outname, "wb");
+    if (file == 0) {
+      fprintf(stderr, "couldn't open %s\n", outname);
+      cpulife_free(&sl);
+      return 1;
+    }
+    fwrite(sl.aa, sizeof(float), (size_t)sl.NX * sl.NY * sl.NZ, file);
+    fclose(file);
+  }
+
+  cpulife_free(&sl);
+  return 0;
+}
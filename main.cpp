@@ -13,11 +13,18 @@
    blobs m			save values (append at the end of config file)
         ,			resize window to client area size 640x480 for
    video recording .			maximize to full screen / restore window
-        -			save buffer as .bmp (2D only)
+        -			save buffer as .bmp (2D) or .nrrd volume (3D)
         crsr		scroll around (also pg up/down in 3D)
         f1/f2		in 3D: rotate box
         f3/f4		auto phase changing speed for color mode 7 and 1
         f5/f6/f7	n dimensions 1,2,3
+        f8			start/stop recording to SmoothLife.y4m (2D: whole
+        			buffer, 1D/3D: window)
+        f9			record every 1st/2nd/4th ... 64th time step
+        f10			3D export with 8/16/32 (float) bits per cell
+        f11			1/2/4 ... 64 time steps per frame or as many as fit in
+        			15 ms (adaptive)
+        f12			turbo: 1000 time steps without drawing (again: stop)
 
         q/a			increase/decrease b1 (with shift factor 10
    faster) w/s			increase/decrease b2 e/d
@@ -33,20 +40,36 @@
         Z/H			dt +/-
         5-9			new size NN=128,256,512,1024,2048 in 2D
    NN=32,64,128,256,512 in 3D
+        </>			next smaller/larger size with FFT radix 2,3,5,7 only
         0/1/2		mode 0/1/2 (discrete/smooth/smooth2 time stepping)
 
         lmb			in 2D move window in 3D rotate box
         wheel		zoom
 
         (/)			set paras to paras from list, paras number -/+
+        P			packed ring and disk convolution on/off
+        B			max FFT radix 8/4/2 (fewer passes / plain radix 2)
+        M			FFT with compute shaders (GL 4.3) or fragment passes
+        N			kernel spectra made analytically or by FFT of the kernels
+        *			buffers float / mixed / half float
+        #			precision report of all presets to SmoothLifePrecision.txt
+        U/J			save checkpoint / restore it (SmoothLifeCheckpoint.slc),
+        			autosave to SmoothLifeAutosave.slc every 5 minutes,
+        			smooth file.slc starts from a checkpoint
 */
 
 #include <SDL/SDL.h>
 #include <SDL/SDL_ttf.h>
 #include <fcntl.h>
 #include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 
+#include "cpublobs.h"
+#include "cpuparas.h"
+#include "cputhreads.h"
 
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
@@ -57,10 +80,16 @@ const double PI =
 
 int dims;  // n dimensions 1, 2 or 3
 
-int NX, NY, NZ;  // buffer size (must be power of 2)
-int BX, BY, BZ;  // buffer size power of 2
+int NX, NY, NZ;  // buffer size (NX even, see smoothsize)
+int BX, BY, BZ;  // n FFT stages (in x +1 for the real/complex stage)
 
-const int BMAX = 16;  // max power of 2 of buffer size (for plan[] arrays)
+const int BMAX = 16;  // max n FFT stages +2 (for plan[] arrays)
+
+int RX[BMAX], RY[BMAX], RZ[BMAX];  // radix of FFT stages 1..BX-1, BY, BZ
+
+const int FFTCMAX = 2048;  // max length of a compute shader FFT row (shared
+                           // memory of 32k for the RGBA buffers)
+const int FFTCRADIX = 4;   // max radix of the compute shader power of 2 stages
 
 // real buffers
 const int AA = 0;   // the buffer
@@ -72,13 +101,20 @@ const int ARB = 5;  // number of real buffers
 
 // Fourier buffers (real and imag part, but half the size in x dimension)
 const int AF = 0;    // FT of buffer
-const int KRF = 1;   // FT of ring kernel
-const int KDF = 2;   // FT of disk kernel
+const int KRF = 1;   // FT of ring kernel (only the real part, see kspecimag)
+const int KDF = 2;   // FT of disk kernel (the same)
 const int ANF = 3;   // FT of buffer blured with ring kernel
 const int AMF = 4;   // FT of buffer blured with disk kernel
 const int FFT0 = 5;  // intermediate FFT buffers (toggle between them)
 const int FFT1 = 6;
-const int AFB = 7;  // number of Fourier buffers
+
+// Fourier buffers with two complex numbers per texel (RGBA), for the packed
+// time step that does ring (rg) and disk (ba) convolution together
+const int KF = 7;     // FT of ring (r) and disk (g) kernel, scaled, RG (real)
+const int ANMF = 8;   // FT of buffer blured with ring and disk kernel
+const int FFT2 = 9;   // intermediate FFT buffers for the packed step
+const int FFT3 = 10;
+const int AFB = 11;  // number of Fourier buffers
 
 double kflr, kfld;  // computed areas of disk and ring kernels
 
@@ -96,6 +132,17 @@ double savedispcnt;  // seconds to display the save confirmation
 int anz;             // buffer view mode 1-4
 int pause;           // pause toggle
 
+const double FRAMEMS = 15.0;  // ms of time steps per frame (adaptive)
+const double TURBOMS = 200.0;  // ms of time steps between events (turbo)
+const long TURBOSTEPS = 1000;  // time steps of one turbo run
+const int MAXSTEPS = 256;      // max time steps per frame (adaptive)
+
+int stepsperframe = 1;  // time steps per drawn frame (key F11), 0 = as many
+                        // as fit in FRAMEMS
+long turbo;             // time steps left to do without drawing (key F12)
+double stepms = 10.0;   // measured ms per time step (adaptive and turbo)
+int framesteps;         // time steps done in the last frame
+
 int ox, oy;                 // offset of drawn buffers rectangle in the window
 int qx, qy;                 // size of drawn buffer rectangle
 int qq;                     // determines zoom for 3D
@@ -110,6 +157,12 @@ int mode;       // time step mode 0 = discrete, 1,2 = smooth
 int sigmode;    // sigmoid construction mode 1-4
 int sigtype;    // sigmoid type 0-9 in n direction
 int mixtype;    // sigmoid type 0-7 in m direction
+int packed;     // ring and disk convolution in one pass chain (RGBA buffers)
+int fftradix;   // max radix of the power of 2 FFT stages (2, 4 or 8)
+int fftcompute;  // FFT with compute shaders (if available) or fragment passes
+int kernelfourier;  // kernel spectra made analytically, without kernel + FFT
+int halfbufs;  // storage of the buffers, 0 all float, 1 the spectra of the
+               // time step as half floats, 2 also AA, AN, AM (halfreal)
 
 double colscheme;  // color scheme 1-7
 double phase;      // phase for color scheme 1 and 7
@@ -117,34 +170,281 @@ double dphase;     // phase changing speed
 double visscheme;  // for 3D visualization scheme
 
 GLuint shader_snm, shader_fft, shader_kernelmul, shader_draw;  // shaders
+GLuint shader_snmv[4][10][8][5];  // snm variants [sigmode-1][sigtype][mixtype]
+                                  // [mode], 0 if not compiled yet
 GLuint shader_copybufferrc, shader_copybuffercr;
+GLuint shader_fft4, shader_kernelmul4,
+    shader_copybuffercr4;  // variants for the RGBA Fourier buffers
+GLuint shader_fftc[3], shader_fftc4[3];  // compute shader FFT for the real
+                                         // and complex image formats of
+                                         // halfbufs 0-2, 0 if not available
 GLuint fb[AFB], tb[AFB];  // Fourier framebuffers and textures
 GLuint fr[ARB], tr[ARB];  // real framebuffers and textures
+int fown[AFB], rown[ARB];  // the buffer whose texture Fourier / real buffer
+                           // t uses, t itself or -1 for none (planbuffers)
 GLuint planx[BMAX][2], plany[BMAX][2],
     planz[BMAX][2];  // plan 1D textures for FFT
-GLuint spfb, sptb;   // buffers for save picture
+GLuint twid[3];      // W_n^k and input order tables of x (n=NX), y, z for
+                     // the compute shader FFT
+GLuint spfb, sptb;   // buffers for save picture and capture, 0 if none
+GLuint passvao, passvbo;  // quads of all shader passes (see makepassquads)
+int quads_rc, quads_cr, quads_f, quads_fx;  // first vertex of each pass kind
+int quads_draw, quads_cube;  // unit draw quad and 3D cube faces in passvbo
 GLenum ttd;          // texture target dimension depending on 1D, 2D, 3D
 
 GLint loc_b1, loc_b2;  // shader variable locations
 GLint loc_d1, loc_d2;
 GLint loc_sn, loc_sm;
-GLint loc_mode, loc_sigmode, loc_sigtype, loc_mixtype, loc_dt;
+GLint loc_dt;
 GLint loc_colscheme, loc_phase, loc_visscheme;
-GLint loc_dim, loc_tang, loc_tangsc, loc_sc;
+GLint loc_tex0, loc_fx, loc_fy, loc_fz, loc_nx, loc_ny, loc_nz;
+GLint loc_dim, loc_tang, loc_tangsc, loc_radix, loc_sc;
+GLint loc_dim4, loc_tang4, loc_tangsc4, loc_radix4, loc_sc4;
+
+// variable locations of a compute shader FFT program (fftc_locations)
+struct fftcloc {
+  GLint axis, mode, n, nb, radix, twstep, si;
+};
+fftcloc loc_fftc[3], loc_fftc4[3];  // of shader_fftc, shader_fftc4
+
+// a shader pass: program, target framebuffer and its texture, input textures
+// on units 0-2 and uniforms, drawn with the pass quads from vertex first on
+//
+struct pass {
+  GLuint prog;
+  GLuint fbo, att;
+  int vw;             // viewport width (height is NY)
+  GLenum target[3];   // input textures, tex 0 = unit not used
+  GLuint tex[3];
+  GLint iloc[3];      // int uniforms, location -1 = not used
+  int ival[3];
+  GLint floc;         // float uniform, location -1 = not used
+  float fval;
+  bool snmparas;      // set the snm paras (they can change between steps)
+  int first;
+  int cls;            // pass class for the GPU timers
+  long bytes;         // bytes read and written (passcost)
+};
+
+const int PMAX = 256;  // max n passes of a time step
+pass steps[PMAX];      // passes of the time step, recorded by its first run
+int nsteps;            // n recorded passes, 0 = record the next time step
+bool recording;        // passes are put into steps[]
+bool stepdirect;       // time step can't be recorded (compute shader FFT)
+
+// pass classes of the GPU timers
+enum { TCOPY, TFFTX, TFFTY, TFFTZ, TMUL, TSNM, TDRAW, TCLASSES };
+const char *tclassname[TCLASSES] = {"copy",      "fft x", "fft y", "fft z",
+                                    "kernelmul", "snm",   "draw"};
+
+const int TFRAMES = 4;         // frames whose timer queries can be in flight
+const int TQMAX = 512;         // max timed segments per frame
+const long TRACEFRAMES = 2000;  // frames written to the trace file
+
+// GPU timer queries of one frame: each segment of consecutive passes of one
+// class has an elapsed time query and a timestamp query at its start
+//
+struct timerframe {
+  GLuint qel[TQMAX], qts[TQMAX];  // 0 if not generated yet
+  int cls[TQMAX];
+  long bytes[TQMAX];
+  int n;         // n segments
+  bool pending;  // results not read yet
+  long nr;       // frame number
+  int steps;     // time steps in the frame
+};
+
+bool timerok;   // GL 3.3 timer queries available
+bool timers;    // GPU timers on (timing info or trace)
+timerframe tframes[TFRAMES];
+int tcur = -1;     // frame the passes are timed into, -1 = none
+int tclass = -1;   // class of the open segment, -1 = none
+long tframenr;     // n frames timed
+double tms[TCLASSES];     // GPU ms per frame of each class (smoothed)
+double tbytes[TCLASSES];  // bytes per frame of each class (smoothed)
+FILE *tracefile;          // Chrome trace (SMOOTHLIFE_TRACE), 0 if none
+long traceframes;         // n frames in it
+GLuint64 tracebase;       // timestamp of its first segment
+
+// key of a kernel: dims, size and ra, rr, rb in 1/1000
+//
+struct kernelkey {
+  int dims, nx, ny, nz;
+  int ra, rr, rb;
+  int analytic;  // made in Fourier space (kernelfourier)
+  int half;      // made with the FFT buffers of halfbufs
+};
+
+// cached spectra of a kernel
+//
+struct kernelspec {
+  kernelkey key;
+  double kflr, kfld;
+  float *spec;         // KRF then KDF, (NX/2+1)*NY*NZ complex each
+  char *map;           // file mapping spec is in, 0 if spec is calloced
+  long bytes;          // size of spec or of the mapping
+  unsigned long used;  // last use (LRU)
+};
+
+// header of a kernelcache/ file, the spectra follow
+//
+struct kernelfilehead {
+  char magic[8];  // "SLKSPEC"
+  kernelkey key;
+  double kflr, kfld;
+  double pad;
+};
+
+// ring (ar) and disk (ad) kernel of a dims dimensional nx*ny*nz grid in the
+// box lo[d] <= x[d] < lo[d]+n[d] around the center (coordinates wrap around),
+// both are 0 outside of it, kr and kd are the areas
+//
+struct kernelbox {
+  int dims, nx, ny, nz;
+  int lo[3], n[3];
+  float *ar, *ad;  // n[0]*n[1]*n[2] each
+  double kr, kd;
+};
+
+// kernel to build in the prefetch thread, exact radii to match a rebuild
+//
+struct kerneljob {
+  kernelkey key;
+  double ra, rr, rb;
+};
+
+const long KCACHEMEM = 256L << 20;  // max bytes of cached kernel spectra
+const int KCACHEN = 64;             // max n cached kernel spectra
+const double KIMAGTOL = 1e-3;       // kernel spectra with larger imaginary
+                                    // parts (relative to the real ones) are
+                                    // reported, float gives 1e-7, the half
+                                    // float AF 1e-4
+kernelspec kcache[KCACHEN];         // kernel spectrum cache (kernelspectra)
+int nkcache;
+unsigned long kcacheuse;            // LRU counter
+
+pthread_t kpthread;  // kernel prefetch thread (kernelprefetch, kernelpoll)
+pthread_mutex_t kpmutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t kpcond = PTHREAD_COND_INITIALIZER;
+bool kprunning;      // thread started
+kerneljob kpjob[4];  // kernels still to build
+int nkpjob;
+bool kpdone;         // kernel kpkey built, waiting for kernelpoll
+kernelkey kpkey;
+kernelbox kpbox;     // its ring and disk kernel
+float *kpspec;       // or its spectra (analytic, kpbox is empty then)
+double kpkflr, kpkfld;
+bool kernelreal;  // KR, KD hold the kernels (they may share AN, AM, whatever
+                  // writes those clears it)
+
+// header of a checkpoint file (keys U, J and autosave), the NX*NY*NZ floats
+// of AA follow at data (page aligned, so a restore can map them)
+//
+struct checkhead {
+  char magic[8];  // "SLCHECK"
+  int version;    // CHECKVERSION
+  int nx, ny, nz;
+  long data;      // file offset of the buffer
+  long stepnr;    // time steps since the blobs
+  unsigned seed;  // seed of the blobs (cpublobs.h)
+  int curparas;
+  struct parameterlist p;  // dims, mode, ra ... sm of the run
+};
+
+const int CHECKVERSION = 1;
+const long CHECKDATA = 4096;  // offset of the buffer in checkpoint files
+const char *CHECKFILE = "SmoothLifeCheckpoint.slc";  // keys U and J
+const char *AUTOFILE = "SmoothLifeAutosave.slc";
+const unsigned long AUTOSAVE = 300000;  // ms between autosaves, 0 = off
+
+long stepnr;    // time steps since the last inita
+unsigned seed;  // blob seed of the last inita
+
+GLuint ckpbo;           // pixel pack buffer AA is read back into
+GLsync ckfence;         // set when the readback is done
+checkhead ckhead;       // header of the checkpoint being saved
+char ckname[256];       // its file name
+float *ckdata;          // the mapped ckpbo while the writer thread has it
+pthread_t ckthread;     // writer thread (checkpointpoll)
+pthread_mutex_t ckmutex = PTHREAD_MUTEX_INITIALIZER;
+bool ckwriting;         // writer thread started
+bool ckdone, ckok;      // writer thread finished, its result
+unsigned long cklast;   // SDL ticks of the last autosave
+checkhead rshead;       // checkpoint being restored (checkpointload)
+char *rsmap;            // its mapping, 0 if none
+long rsbytes;
+
+const int CAPRING = 4;  // frames in flight between readback and writer
+const int CAPFPS = 30;  // frame rate written into the y4m header
+const char *CAPFILE = "SmoothLife.y4m";  // key F8, SMOOTHLIFE_CAPTURE in the
+                                         // environment overrides it
+
+enum { CAPFREE, CAPREAD, CAPMAPPED, CAPDONE };  // capframe states
+
+// frame of the capture ring: read back into pbo by the GPU (CAPREAD), mapped
+// by capturepoll and handed to the writer thread (CAPMAPPED), unmapped by
+// capturepoll when written (CAPDONE)
+//
+struct capframe {
+  GLuint pbo;
+  GLsync fence;
+  unsigned char *data;  // the mapped pbo, 0 if mapping failed
+  int state;            // capmutex
+};
+
+bool capturing;     // recording (key F8)
+int capevery = 1;   // record every capevery-th time step (key F9)
+int capw, caph;     // frame size
+bool capflip;       // frames read back bottom row first (window)
+bool capy4m;        // y4m stream, else raw rgb24 frames
+bool cappipe;       // written to a command (popen)
+FILE *capfile;
+capframe capring[CAPRING];
+int capnext;        // next frame of the ring to read back into
+long capframes;     // n frames recorded
+long capwaits;      // n times the time step had to wait for a free frame
+pthread_t capthread;
+pthread_mutex_t capmutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t capcond = PTHREAD_COND_INITIALIZER;  // a frame changed state
+bool capquit;  // writer thread should end (capmutex)
+bool capok;    // all frames written (capmutex)
+
+const int EXPORTSLAB = 16;  // z slices per slab of the 3D export
+const int EXPORTRING = 4;   // slabs in flight
+
+// slab of the 3D export being read back
+//
+struct exportslab {
+  GLuint pbo;
+  GLsync fence;
+  int z0, nz;  // first slice, n slices
+};
 
+bool exporting;      // 3D export running (key -)
+int exportbits = 8;  // 8, 16 or 32 (float) bits per cell (key F10)
+int exbits;          // bits, size and name of the running export
+int exnx, exny, exnz;
+char exname[64];
+FILE *exfile;
+GLuint extex, exfb;  // snapshot of AA the slabs are read from, its framebuffer
+exportslab exring[EXPORTRING];
+int exhead, exinflight;  // oldest slab of the ring, n slabs in flight
+int exz;                 // next slice to read back
+unsigned long exticks;   // SDL ticks at the start
+
+const int PRECSTEPS = 100;    // time steps of each precision report run
+const unsigned PRECSEED = 1;  // blob seed of the runs
+const double PRECTOL = 0.05;  // relative difference of the buffer mean to
+                              // the float run a paras set survives with
+const double PRECMIN = 0.02;  // smaller means count as this (nearly dead)
+const char *PRECFILE = "SmoothLifePrecision.txt";
+
+bool layered;  // 3D passes draw all slices in one go (vertex shader gl_Layer)
+bool computeok;  // GL 4.3 compute shaders available
+bool clearok;    // GL 4.4 glClearTexImage available
 bool neu;      // new buffer size
 bool neuedim;  // new paras
 
-const int DESCSIZE = 64;
-struct parameterlist  // list with all parameter lines from the config file
-{
-  int dims, mode;
-  double ra, rr, rb, dt;
-  double b1, d1, b2, d2;
-  int sigmode, sigtype, mixtype;
-  double sn, sm;
-  char desc[DESCSIZE];  // description text
-};
 struct parameterlist paralist[1000];  // parameter list, max 1000 entries
 int nparas;                           // n paras in list
 int curparas;                         // current paras number in list
@@ -155,64 +455,16 @@ int ypos;               // y position for 1D drawing
 GLuint fonttex[256];         // for drawtext
 int fontw[256], fonth[256];  // size of each character
 
-// return random floating point number 0 <= n < x
-//
-double RND(double x) { return x * (double)rand() / ((double)RAND_MAX + 1); }
+const long INITCELLS = 1L << 22;  // cells filled with blobs per upload
 
 // read all paras from config file into paraslist
 //
 bool read_config(void) {
-  FILE *file;
-  int l, t, d;
-  char buf[256], desc[256];
-  bool gef;
-
-  file = fopen("SmoothLifeConfig.txt", "r");
-  if (file == 0) return false;
-
-  l = 0;  // read lines
-  for (;;) {
-    char *bla = fgets(buf, 256, file);
-    if (feof(file)) break;
-
-    if (!(buf[0] == '1' || buf[0] == '2' || buf[0] == '3')) continue;
-
-    sscanf(buf, "%d %d  %lf %lf %lf %lf  %lf %lf %lf %lf  %d %d %d  %lf %lf",
-           &dims, &mode, &ra, &rr, &rb, &dt, &b1, &b2, &d1, &d2, &sigmode,
-           &sigtype, &mixtype, &sn, &sm);
-
-    t = 0;  // read description
-    d = 0;
-    gef = false;
-    do {
-      if (buf[t] == '/') gef = true;
-      if (d < DESCSIZE - 2 && gef) desc[d++] = buf[t];
-    } while (buf[t++] != '\0');
-    desc[d] = '\0';
-
-    paralist[l].dims = dims;
-    paralist[l].mode = mode;
-    paralist[l].ra = ra;
-    paralist[l].rr = rr;
-    paralist[l].rb = rb;
-    paralist[l].dt = dt;
-    paralist[l].b1 = b1;
-    paralist[l].b2 = b2;
-    paralist[l].d1 = d1;
-    paralist[l].d2 = d2;
-    paralist[l].sigmode = sigmode;
-    paralist[l].sigtype = sigtype;
-    paralist[l].mixtype = mixtype;
-    paralist[l].sn = sn;
-    paralist[l].sm = sm;
-    strcpy(paralist[l].desc, desc);
-
-    l++;
-  }
-
-  nparas = l;
-
-  fclose(file);
+  nparas = read_paralist("SmoothLifeConfig.txt", paralist, 1000);
+  if (nparas < 0) {
+    nparas = 0;
+    return false;
+  }
 
   fprintf(logfile, "%d parameter lines read from config file\n", nparas);
   fflush(logfile);
@@ -252,29 +504,53 @@ bool write_config(void) {
   return true;
 }
 
+// set paras to p (not desc)
+//
+void putparas(const struct parameterlist &p) {
+  dims = p.dims;
+  mode = p.mode;
+  ra = p.ra;
+  rr = p.rr;
+  rb = p.rb;
+  dt = p.dt;
+  b1 = p.b1;
+  b2 = p.b2;
+  d1 = p.d1;
+  d2 = p.d2;
+  sigmode = p.sigmode;
+  sigtype = p.sigtype;
+  mixtype = p.mixtype;
+  sn = p.sn;
+  sm = p.sm;
+}
+
+// current paras into p (not desc)
+//
+void getparas(struct parameterlist &p) {
+  p.dims = dims;
+  p.mode = mode;
+  p.ra = ra;
+  p.rr = rr;
+  p.rb = rb;
+  p.dt = dt;
+  p.b1 = b1;
+  p.b2 = b2;
+  p.d1 = d1;
+  p.d2 = d2;
+  p.sigmode = sigmode;
+  p.sigtype = sigtype;
+  p.mixtype = mixtype;
+  p.sn = sn;
+  p.sm = sm;
+}
+
 // set paras to paras number l from list
 //
 void setparas(int l) {
-  if (l >= 0 && l < nparas) {
-    dims = paralist[l].dims;
-    mode = paralist[l].mode;
-    ra = paralist[l].ra;
-    rr = paralist[l].rr;
-    rb = paralist[l].rb;
-    dt = paralist[l].dt;
-    b1 = paralist[l].b1;
-    b2 = paralist[l].b2;
-    d1 = paralist[l].d1;
-    d2 = paralist[l].d2;
-    sigmode = paralist[l].sigmode;
-    sigtype = paralist[l].sigtype;
-    mixtype = paralist[l].mixtype;
-    sn = paralist[l].sn;
-    sm = paralist[l].sm;
-  }
-}
-
-// make a buffer for mysavepic
+  if (l >= 0 && l < nparas) putparas(paralist[l]);
+}
+
+// make a buffer for mysavepic and capturestep (NX*NY, made once per size)
 //
 bool create_render_buffer(void) {
   unsigned int err;
@@ -359,6 +635,34 @@ bool delete_render_buffer(void) {
   return true;
 }
 
+// draw the unit quad of passvbo (or its first edge for GL_LINES) as the
+// rectangle from x, y with width w and height h, texture unit 0 from tx, ty
+// with height th (negative for upside down)
+//
+void drawunitquad(GLenum mode, double x, double y, double w, double h,
+                  double tx, double ty, double th) {
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glTranslated(x, y, 0);
+  glScaled(w, h, 1);
+
+  glActiveTexture(GL_TEXTURE0);
+  glMatrixMode(GL_TEXTURE);
+  glPushMatrix();
+  glLoadIdentity();
+  glTranslated(tx, ty, 0);
+  glScaled(1, th, 1);
+
+  glBindVertexArray(passvao);
+  glDrawArrays(mode, quads_draw, mode == GL_LINES ? 2 : 4);
+  glBindVertexArray(0);
+
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+}
+
 // draw buffer for mysavepic
 //
 void drawa_render_buffer(int a) {
@@ -377,18 +681,9 @@ void drawa_render_buffer(int a) {
 
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, tr[a]);
-  glUniform1i(glGetUniformLocation(shader_draw, "tex0"), 0);
-
-  glBegin(GL_QUADS);
-  glMultiTexCoord2d(GL_TEXTURE0, fx, fy + 1);
-  glVertex2i(0, 0);  // upside down for bmp format
-  glMultiTexCoord2d(GL_TEXTURE0, fx + 1, fy + 1);
-  glVertex2i(NX, 0);
-  glMultiTexCoord2d(GL_TEXTURE0, fx + 1, fy);
-  glVertex2i(NX, NY);
-  glMultiTexCoord2d(GL_TEXTURE0, fx, fy);
-  glVertex2i(0, NY);
-  glEnd();
+  glUniform1i(loc_tex0, 0);
+
+  drawunitquad(GL_QUADS, 0, 0, NX, NY, fx, fy + 1, -1);  // upside down for bmp
 
   glUseProgram(0);
 }
@@ -401,11 +696,12 @@ void mysavepic(void) {
   char *buffer;
   SDL_Surface *surf;
 
-  create_render_buffer();
+  if (spfb == 0) create_render_buffer();  // kept until delete_buffers
   drawa_render_buffer(AA);
 
   buffer = (char *)calloc(3 * NX * NY, sizeof(char));
   glReadPixels(0, 0, NX, NY, GL_BGR, GL_UNSIGNED_BYTE, buffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
   surf = SDL_CreateRGBSurfaceFrom(buffer, NX, NY, 24, NX * 3, 0xff0000,
                                   0x00ff00, 0x0000ff, 0);
@@ -415,7 +711,6 @@ void mysavepic(void) {
 
   SDL_FreeSurface(surf);
   free(buffer);
-  delete_render_buffer();
 
   bildnr++;
 }
@@ -458,9 +753,11 @@ bool printProgramInfoLog(GLuint obj) {
   return infologLength > 2;
 }
 
-// read .vert and .frag shaders from the files in the shader directory
+// read .vert and .frag shaders from the files in the shader directory,
+// consts (if not NULL) is put in front of the .frag source
 //
-bool setShaders(int dim, char *fname, GLuint &prog) {
+bool setShaders(int dim, char *fname, GLuint &prog,
+                const char *consts = NULL) {
   char *vs = NULL, *fs = NULL, *gs = NULL;
 
   FILE *fp;
@@ -503,47 +800,28 @@ bool setShaders(int dim, char *fname, GLuint &prog) {
   }
   fclose(fp);
 
-  // insert constants into the shader source code (not used)
-  char w4[256];
-  int t, d, w;
-
-  t = 0;
-  while (fs[t] != '\0') t++;
-
-  gs = (char *)calloc(t * 2, sizeof(char));
-
-  t = 0;
-  d = 0;
-  w4[0] = '\0';
-
-  do {
-    w = 0;
-    while (!(fs[t] == ' ' || fs[t] == '\n' || fs[t] == '\0')) {
-      w4[w] = fs[t];
-      w++;
-      t++;
-    }
-    w4[w] = '\0';
-
-    w = 0;
-    while (w4[w] != '\0') {
-      gs[d] = w4[w];
-      d++;
-      w++;
-    }
-
-    while (fs[t] == ' ' || fs[t] == '\n' || fs[t] == '\0') {
-      gs[d] = fs[t];
-      if (fs[t] == '\0') break;
-      d++;
-      t++;
-    }
-  } while (fs[t] != '\0');
+  // insert constants into the shader source code (in front of it, there's
+  // no #version line to keep first)
+  int t = 0;
+  if (consts) t = strlen(consts);
+  gs = (char *)calloc(t + strlen(fs) + 1, sizeof(char));
+  if (consts) strcpy(gs, consts);
+  strcat(gs, fs);
+
+  // 3D vertex shaders pick the target slice themselves (see drawpass)
+  if (dim == 3 && layered) {
+    const char *ls = "#define LAYERED\n";
+    char *vl = (char *)calloc(strlen(ls) + strlen(vs) + 1, sizeof(char));
+    strcpy(vl, ls);
+    strcat(vl, vs);
+    free(vs);
+    vs = vl;
+  }
 
   /*FILE *file;
   sprintf (filename, "%s.test", fname);
   file = fopen (filename, "w");
-  fwrite (gs, 1, d, file);
+  fwrite (gs, 1, strlen (gs), file);
   fclose (file);*/
 
   GLuint v, f;
@@ -597,10 +875,99 @@ bool setShaders(int dim, char *fname, GLuint &prog) {
     fflush(logfile);
   }
 
+  // samplers tex0, tex1, tex2 always read texture units 0, 1, 2
+  glUseProgram(prog);
+  glUniform1i(glGetUniformLocation(prog, "tex0"), 0);
+  glUniform1i(glGetUniformLocation(prog, "tex1"), 1);
+  glUniform1i(glGetUniformLocation(prog, "tex2"), 2);
+  glUseProgram(0);
+
   // return ret;		// doesn't work with ati, so...
   return 0;
 }
 
+// read a compute shader from shaders/<fname><dim>D.comp, #version 430 and
+// consts (if not NULL) are put in front of it, prog is 0 if it doesn't
+// compile or link (returns true then)
+//
+bool setComputeShader(int dim, char *fname, GLuint &prog,
+                      const char *consts = NULL) {
+  char *cs = NULL;
+
+  FILE *fp;
+  int count = 0;
+  char filename[128];
+
+  prog = 0;
+  fprintf(logfile, "setting compute shader: %s\n", fname);
+
+  sprintf(filename, "shaders/%s%dD.comp", fname, dim);
+  fp = fopen(filename, "rt");
+  if (fp == NULL) {
+    fprintf(logfile, "couldn't open .comp\n");
+    fflush(logfile);
+    return true;
+  }
+  fseek(fp, 0, SEEK_END);
+  count = ftell(fp);
+  rewind(fp);
+  cs = (char *)calloc(count + 1, sizeof(char));
+  count = fread(cs, sizeof(char), count, fp);
+  cs[count] = '\0';
+  fclose(fp);
+
+  const char *src[3] = {"#version 430\n", consts ? consts : "", cs};
+  GLuint c = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(c, 3, src, NULL);
+  free(cs);
+
+  GLint ok;
+  glCompileShader(c);
+  printShaderInfoLog(c);
+  glGetShaderiv(c, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    fprintf(logfile, "error in compute shader!\n\n");
+    fflush(logfile);
+    glDeleteShader(c);
+    return true;
+  }
+
+  prog = glCreateProgram();
+  glAttachShader(prog, c);
+  glLinkProgram(prog);
+  glDeleteShader(c);
+  printProgramInfoLog(prog);
+  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    fprintf(logfile, "compute shader program error!\n\n");
+    fflush(logfile);
+    glDeleteProgram(prog);
+    prog = 0;
+    return true;
+  }
+  fprintf(logfile, "compute shader program ok\n\n");
+  fflush(logfile);
+
+  // the twiddle and index table tw always reads texture unit 0
+  glUseProgram(prog);
+  glUniform1i(glGetUniformLocation(prog, "tw"), 0);
+  glUseProgram(0);
+
+  return false;
+}
+
+// look up the variables of compute shader FFT program prog once
+//
+void fftc_locations(GLuint prog, fftcloc &l) {
+  l.axis = glGetUniformLocation(prog, "axis");
+  l.mode = glGetUniformLocation(prog, "mode");
+  l.n = glGetUniformLocation(prog, "n");
+  l.nb = glGetUniformLocation(prog, "nb");
+  l.radix = glGetUniformLocation(prog, "radix");
+  l.twstep = glGetUniformLocation(prog, "twstep");
+  l.si = glGetUniformLocation(prog, "si");
+}
+
 // delete shader programs (doesn't delete shaders, but whatever)
 //
 void delShaders(void) {
@@ -639,219 +1006,384 @@ void delShaders(void) {
   fprintf(logfile, "DeleteProgram kernelmul err %d\n", err);
   fflush(logfile);
 
-  glDeleteProgram(shader_snm);
+  glDeleteProgram(shader_fft4);
+  glDeleteProgram(shader_kernelmul4);
+  glDeleteProgram(shader_copybuffercr4);
   err = glGetError();
-  fprintf(logfile, "DeleteProgram snm err %d\n", err);
+  fprintf(logfile, "DeleteProgram fft4 kernelmul4 copybuffercr4 err %d\n", err);
+  fflush(logfile);
+
+  for (int v = 0; v < 3; v++) {
+    glDeleteProgram(shader_fftc[v]);
+    glDeleteProgram(shader_fftc4[v]);
+    shader_fftc[v] = 0;
+    shader_fftc4[v] = 0;
+  }
+  err = glGetError();
+  fprintf(logfile, "DeleteProgram fftc fftc4 err %d\n", err);
   fflush(logfile);
-}
 
-// put this in all tight nested for-loops to stay responsive
-//
-void dosystem(void) {
-  // SDL_Event event;
-  // SDL_PollEvent (&event);
-}
-
-// put a 3D splat in buf
-//
-void splat3D(float *buf) {
-  double mx, my, mz, dx, dy, dz, u, l;
-  int ix, iy, iz;
-
-  mx = RND(NX);
-  my = RND(NY);
-  mz = RND(NZ);
-  u = ra * (RND(0.5) + 0.5);
-
-  for (iz = (int)(mz - u - 1); iz <= (int)(mz + u + 1); iz++)
-    for (iy = (int)(my - u - 1); iy <= (int)(my + u + 1); iy++)
-      for (ix = (int)(mx - u - 1); ix <= (int)(mx + u + 1); ix++) {
-        dx = mx - ix;
-        dy = my - iy;
-        dz = mz - iz;
-        l = sqrt(dx * dx + dy * dy + dz * dz);
-        if (l < u) {
-          int px = ix;
-          int py = iy;
-          int pz = iz;
-          while (px < 0) px += NX;
-          while (px >= NX) px -= NX;
-          while (py < 0) py += NY;
-          while (py >= NY) py -= NY;
-          while (pz < 0) pz += NZ;
-          while (pz >= NZ) pz -= NZ;
-          if (px >= 0 && px < NX && py >= 0 && py < NY && pz >= 0 && pz < NZ) {
-            *(buf + NX * NY * pz + NX * py + px) = 1.0;
+  int n = 0;
+  for (int a = 0; a < 4; a++)
+    for (int b = 0; b < 10; b++)
+      for (int c = 0; c < 8; c++)
+        for (int d = 0; d < 5; d++)
+          if (shader_snmv[a][b][c][d]) {
+            glDeleteProgram(shader_snmv[a][b][c][d]);
+            shader_snmv[a][b][c][d] = 0;
+            n++;
           }
-        }
-        dosystem();
-      }
+  shader_snm = 0;
+  err = glGetError();
+  fprintf(logfile, "DeleteProgram snm (%d variants) err %d\n", n, err);
+  fflush(logfile);
+}
+
+// forget the recorded time step, the next one records its passes again (new
+// buffers, kernel, snm shader or pass chain)
+//
+void newsteps(void) {
+  nsteps = 0;
+  stepdirect = false;
 }
 
-// init 3D buffer with splats
+// make shader_snm the snm variant for the current sigmode, sigtype, mixtype
+// and mode, they are inserted as constants and the variant is compiled on
+// first use and kept until delShaders
 //
-void inita3D(int a) {
-  float *buf = (float *)calloc(NX * NY * NZ, sizeof(float));
+bool setsnmvariant(void) {
+  int a = sigmode < 1 ? 1 : (sigmode > 4 ? 4 : sigmode);
+  int b = sigtype < 0 ? 0 : (sigtype > 9 ? 9 : sigtype);
+  int c = mixtype < 0 ? 0 : (mixtype > 7 ? 7 : mixtype);
+  int d = mode < 0 ? 0 : (mode > 4 ? 4 : mode);
+  GLuint &prog = shader_snmv[a - 1][b][c][d];
+
+  if (prog == 0) {
+    char consts[256];
+    sprintf(consts,
+            "#define SNMCONST\n"
+            "const float sigmode = %d.0;\n"
+            "const float sigtype = %d.0;\n"
+            "const float mixtype = %d.0;\n"
+            "const float mode = %d.0;\n",
+            a, b, c, d);
+    if (setShaders(dims, (char *)"snm", prog, consts)) return true;
+  }
+  if (prog == shader_snm) return false;
+  shader_snm = prog;
+  newsteps();
+
+  loc_dt = glGetUniformLocation(shader_snm, "dt");
+  loc_b1 = glGetUniformLocation(shader_snm, "b1");
+  loc_b2 = glGetUniformLocation(shader_snm, "b2");
+  loc_d1 = glGetUniformLocation(shader_snm, "d1");
+  loc_d2 = glGetUniformLocation(shader_snm, "d2");
+  loc_sn = glGetUniformLocation(shader_snm, "sn");
+  loc_sm = glGetUniformLocation(shader_snm, "sm");
+  return false;
+}
 
-  double mx, my, mz;
+// init buffer with the blobs of seed s, INITCELLS at a time: the slices are
+// filled by all threads and go into the texture with glTexSubImage, so the
+// texture is not reallocated and the same seed always gives the same buffer
+// (also in the headless CPU engine)
+//
+void initaseed(int a, unsigned s) {
+  struct blobset bs;
+  float *buf;
+  int s0, ns, chunk;
+  long cells;
 
-  mx = 2 * ra;
-  if (mx > NX) mx = NX;
-  my = 2 * ra;
-  if (my > NY) my = NY;
-  mz = 2 * ra;
-  if (mz > NZ) mz = NZ;
+  seed = s;  // so a checkpoint knows the blobs
+  stepnr = 0;
 
-  for (int t = 0; t <= (int)(NX * NY * NZ / (mx * my * mz)); t++) {
-    splat3D(buf);
+  if (!blobs_make(&bs, dims, NX, NY, NZ, ra, seed)) {
+    fprintf(logfile, "no memory for the blobs\n");
+    return;
+  }
+  cells = dims == 3 ? (long)NX * NY : NX;  // cells per slice
+  chunk = (int)(INITCELLS / cells);
+  if (chunk < 1) chunk = 1;
+  if (chunk > bs.nslice) chunk = bs.nslice;
+  buf = (float *)calloc(chunk * cells, sizeof(float));
+  if (!buf) {
+    fprintf(logfile, "no memory for the blobs\n");
+    blobs_free(&bs);
+    return;
   }
 
-  glBindTexture(GL_TEXTURE_3D, tr[a]);
-  glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, NX, NY, NZ, 0, GL_RED, GL_FLOAT, buf);
+  glBindTexture(ttd, tr[a]);
+  for (s0 = 0; s0 < bs.nslice; s0 += chunk) {
+    ns = bs.nslice - s0 < chunk ? bs.nslice - s0 : chunk;
+    blobs_fill(&bs, buf, s0, ns);
+    if (dims == 1)
+      glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX, GL_RED, GL_FLOAT, buf);
+    if (dims == 2)
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, s0, NX, ns, GL_RED, GL_FLOAT, buf);
+    if (dims == 3)
+      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, s0, NX, NY, ns, GL_RED,
+                      GL_FLOAT, buf);
+  }
+  glBindTexture(ttd, 0);
 
   free(buf);
+  blobs_free(&bs);
 }
 
-// put a 2D splat in buf
-//
-void splat2D(float *buf) {
-  double mx, my, dx, dy, u, l;
-  int ix, iy;
-
-  mx = RND(NX);
-  my = RND(NY);
-  u = ra * (RND(0.5) + 0.5);
-
-  for (iy = (int)(my - u - 1); iy <= (int)(my + u + 1); iy++)
-    for (ix = (int)(mx - u - 1); ix <= (int)(mx + u + 1); ix++) {
-      dx = mx - ix;
-      dy = my - iy;
-      l = sqrt(dx * dx + dy * dy);
-      if (l < u) {
-        int px = ix;
-        int py = iy;
-        while (px < 0) px += NX;
-        while (px >= NX) px -= NX;
-        while (py < 0) py += NY;
-        while (py >= NY) py -= NY;
-        if (px >= 0 && px < NX && py >= 0 && py < NY) {
-          *(buf + NX * py + px) = 1.0;
-        }
-      }
-      dosystem();
-    }
+// init buffer with the blobs of a new seed
+//
+void inita(int a) {
+  initaseed(a, (unsigned)rand());
 }
 
-// init 2D buffer with splats
+// coordinates for the 3D cube
 //
-void inita2D(int a) {
-  float *buf = (float *)calloc(NX * NY, sizeof(float));
+int cube[6][4][3] = {{{1, 1, -1}, {-1, 1, -1}, {-1, 1, 1}, {1, 1, 1}},
+                     {{1, -1, 1}, {-1, -1, 1}, {-1, -1, -1}, {1, -1, -1}},
+                     {{1, 1, 1}, {-1, 1, 1}, {-1, -1, 1}, {1, -1, 1}},
+                     {{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}},
+                     {{-1, 1, 1}, {-1, 1, -1}, {-1, -1, -1}, {-1, -1, 1}},
+                     {{1, 1, -1}, {1, 1, 1}, {1, -1, 1}, {1, -1, -1}}};
 
-  double mx, my;
+// append the quads of one pass kind to v from vertex n on (vertex x, y, z and
+// 3 texture coordinates x, y, z each), one quad per slice: x runs from the
+// left edge of the viewport to xe (a fraction of its width) and y over all
+// of it, in clip coordinates, z is the slice for the layered 3D passes,
+// texture unit u gets x from s0[u] to s1[u], y from 0 to 1 and the slice
+// center, returns the vertex after the quads
+//
+int passquads(float *v, int n, double xe, const double *s0, const double *s1) {
+  int t, c, u;
+
+  for (t = 0; t < NZ; t++)
+    for (c = 0; c < 4; c++) {
+      int cx = c == 1 || c == 2;
+      int cy = c >= 2;
+      float *p = v + n * 12;
+      p[0] = (float)(-1.0 + 2.0 * xe * cx);
+      p[1] = (float)(-1.0 + 2.0 * cy);
+      p[2] = (float)t;
+      for (u = 0; u < 3; u++) {
+        p[3 + u * 3] = (float)(cx ? s1[u] : s0[u]);
+        p[4 + u * 3] = dims > 1 ? (float)cy : 0.0f;
+        p[5 + u * 3] = dims > 2 ? (float)((t + 0.5) / NZ) : 0.0f;
+      }
+      n++;
+    }
 
-  mx = 2 * ra;
-  if (mx > NX) mx = NX;
-  my = 2 * ra;
-  if (my > NY) my = NY;
+  return n;
+}
 
-  for (int t = 0; t <= (int)(NX * NY / (mx * my)); t++) {
-    splat2D(buf);
+// append the quads drawn to the screen to v from vertex n on: the unit quad
+// (vertex and texture coordinates from 0 to 1, placed by the modelview and
+// texture matrices, its first edge is the 1D line) and the 6 faces of the 3D
+// cube of the current size, returns the vertex after them
+//
+int drawquads(float *v, int n) {
+  int s, c, u;
+
+  quads_draw = n;
+  for (c = 0; c < 4; c++) {
+    float *p = v + n * 12;
+    p[0] = (float)(c == 1 || c == 2);
+    p[1] = (float)(c >= 2);
+    for (u = 0; u < 3; u++) {
+      p[3 + u * 3] = p[0];
+      p[4 + u * 3] = p[1];
+    }
+    n++;
   }
 
-  glBindTexture(GL_TEXTURE_2D, tr[a]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, GL_RED, GL_FLOAT, buf);
+  quads_cube = n;
+  for (s = 0; s < 6; s++)
+    for (c = 0; c < 4; c++) {
+      float *p = v + n * 12;
+      p[0] = (float)(NX / 2 * cube[s][c][0]);
+      p[1] = (float)(NY / 2 * cube[s][c][1]);
+      p[2] = (float)(NZ / 2 * cube[s][c][2]);
+      n++;
+    }
 
-  free(buf);
+  return n;
 }
 
-// put a 1D splat in buf
+// make the vertex buffer and array with the quads of all shader passes and
+// of drawa for the current size, quads_rc etc. are their first vertices
 //
-void splat1D(float *buf) {
-  double mx, dx, u, l;
-  int ix;
+bool makepassquads(void) {
+  unsigned int err;
+  double h = 1.0 / (NX / 2 + 1);
+
+  // copybufferrc, tex0 and tex1 at the even and odd real texel of a pair
+  double rc0[3] = {-0.5 / NX, 0.5 / NX, 0};
+  double rc1[3] = {1 - 0.5 / NX, 1 + 0.5 / NX, 1};
+  // copybuffercr, tex1 in texels
+  double cr0[3] = {0, 0, 0}, cr1[3] = {1 - h, (double)NX, 1};
+  // all texels (kernelmul, snm, FFT stages on NX/2+1 points)
+  double f0[3] = {0, 0, 0}, f1[3] = {1, 1, 1};
+  // FFT stages in x on NX/2 points
+  double fx1[3] = {1 - h, 1 - h, 1};
+
+  float *v = (float *)calloc((4 * NZ * 4 + 4 + 6 * 4) * 12, sizeof(float));
+  if (v == 0) {
+    fprintf(logfile, "makepassquads failed\n");
+    fflush(logfile);
+    return false;
+  }
 
-  mx = RND(NX);
-  u = ra * (RND(0.5) + 0.5);
+  int n = 0;
+  quads_rc = n;
+  n = passquads(v, n, NX / 2 * h, rc0, rc1);
+  quads_cr = n;
+  n = passquads(v, n, 1.0, cr0, cr1);
+  quads_f = n;
+  n = passquads(v, n, 1.0, f0, f1);
+  quads_fx = n;
+  n = passquads(v, n, NX / 2 * h, f0, fx1);
+  n = drawquads(v, n);
+
+  glGenVertexArrays(1, &passvao);
+  glBindVertexArray(passvao);
+  glGenBuffers(1, &passvbo);
+  glBindBuffer(GL_ARRAY_BUFFER, passvbo);
+  glBufferData(GL_ARRAY_BUFFER, n * 12 * sizeof(float), v, GL_STATIC_DRAW);
+  free(v);
+  err = glGetError();
+  fprintf(logfile, "BufferData err %d\n", err);
+  fflush(logfile);
+  if (err) return false;
 
-  for (ix = (int)(mx - u - 1); ix <= (int)(mx + u + 1); ix++) {
-    dx = mx - ix;
-    l = sqrt(dx * dx);
-    if (l < u) {
-      int px = ix;
-      while (px < 0) px += NX;
-      while (px >= NX) px -= NX;
-      if (px >= 0 && px < NX) {
-        *(buf + px) = 1.0;
-      }
-    }
-    dosystem();
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 12 * sizeof(float), (void *)0);
+  for (int u = 0; u < 3; u++) {
+    glClientActiveTexture(GL_TEXTURE0 + u);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(3, GL_FLOAT, 12 * sizeof(float),
+                      (void *)((3 + u * 3) * sizeof(float)));
   }
+  glClientActiveTexture(GL_TEXTURE0);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  err = glGetError();
+  fprintf(logfile, "VertexArray err %d\n", err);
+  fflush(logfile);
+  if (err) return false;
+
+  return true;
 }
 
-// init a 1D buffer with splats
+// is real buffer t stored as half floats? the kernels KR, KD stay float
 //
-void inita1D(int a) {
-  float *buf = (float *)calloc(NX, sizeof(float));
-
-  double mx;
+bool halfreal(int t) {
+  return halfbufs == 2 && (t == AA || t == AN || t == AM);
+}
 
-  mx = 2 * ra;
-  if (mx > NX) mx = NX;
+// is Fourier buffer t stored as half floats? the kernel spectra KRF, KDF,
+// KF are made once and stay float, the others are rewritten every step
+//
+bool halffourier(int t) {
+  return halfbufs > 0 && t != KRF && t != KDF && t != KF;
+}
 
-  for (int t = 0; t <= (int)(NX / mx); t++) {
-    splat1D(buf);
-  }
+// internal format of real buffer t
+//
+GLenum realfmt(int t) { return halfreal(t) ? GL_R16F : GL_R32F; }
 
-  glBindTexture(GL_TEXTURE_1D, tr[a]);
-  glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, NX, 0, GL_RED, GL_FLOAT, buf);
+// channels of Fourier buffer t, the kernel spectra are real (KF holds two)
+//
+int fourierchannels(int t) {
+  if (t == KRF || t == KDF) return 1;
+  return t > KF ? 4 : 2;
+}
 
-  free(buf);
+// internal format of Fourier buffer t
+//
+GLenum fourierfmt(int t) {
+  int c = fourierchannels(t);
+  if (c == 1) return halffourier(t) ? GL_R16F : GL_R32F;
+  if (c == 4) return halffourier(t) ? GL_RGBA16F : GL_RGBA32F;
+  return halffourier(t) ? GL_RG16F : GL_RG32F;
 }
 
-// init buffer with splats
+// bytes of a texel of real buffer t and Fourier buffer t
 //
-void inita(int a) {
-  if (dims == 1) inita1D(a);
-  if (dims == 2) inita2D(a);
-  if (dims == 3) inita3D(a);
+int realbytes(int t) { return halfreal(t) ? 2 : 4; }
+
+int fourierbytes(int t) {
+  return fourierchannels(t) * (halffourier(t) ? 2 : 4);
 }
 
-// create real and Fourier buffers
+// storage plan of the buffers for packed and halfbufs, a buffer uses the
+// texture of another one of the same format if their contents are never
+// needed at the same time:
+// KR, KD use AN, AM, the kernels are only needed for their FFT (and the
+// kernel views), AN, AM only from the inverse FFTs to snm
+// ANF, AMF use FFT0 (ANMF FFT2), the inverse FFT reads them in its first
+// stage before it writes FFT0, the unpacked step does one kernel product and
+// its inverse FFT after the other
+// KRF, KDF aren't used by the packed step (the kernels are transformed in AF
+// and packed into KF), KF, ANMF, FFT2, FFT3 not by the unpacked step
 //
-bool create_buffers(void) {
-  unsigned int err;
-  int t, s, eb;
+void planbuffers(void) {
+  int t;
 
-  if (dims == 1) {
-    fprintf(logfile, "create buffers 1D %d\n", NX);
-    fflush(logfile);
-  } else if (dims == 2) {
-    fprintf(logfile, "create buffers 2D %d %d\n", NX, NY);
-    fflush(logfile);
-  } else  // dims==3
-  {
-    fprintf(logfile, "create buffers 3D %d %d %d\n", NX, NY, NZ);
-    fflush(logfile);
+  for (t = 0; t < ARB; t++) rown[t] = t;
+  for (t = 0; t < AFB; t++) fown[t] = t;
+
+  if (realfmt(KR) == realfmt(AN)) {
+    rown[KR] = AN;
+    rown[KD] = AM;
   }
 
-  // Fourier (complex) buffers
+  fown[ANF] = FFT0;
+  fown[AMF] = FFT0;
+  if (packed) {
+    fown[KRF] = -1;
+    fown[KDF] = -1;
+    fown[ANMF] = FFT2;
+  } else {
+    for (t = KF; t < AFB; t++) fown[t] = -1;
+  }
+}
 
-  glGenTextures(AFB, &tb[0]);
-  err = glGetError();
-  fprintf(logfile, "GenTextures err %d\n", err);
-  fflush(logfile);
-  if (err) return false;
+// bytes of the textures of the storage plan
+//
+long bufferbytes(void) {
+  long nr = (long)NX * NY * NZ, nf = (long)(NX / 2 + 1) * NY * NZ, s = 0;
+  int t;
 
-  glGenFramebuffers(AFB, &fb[0]);
-  err = glGetError();
-  fprintf(logfile, "GenFramebuffers err %d\n", err);
-  fflush(logfile);
-  if (err) return false;
+  for (t = 0; t < ARB; t++)
+    if (rown[t] == t) s += nr * realbytes(t);
+  for (t = 0; t < AFB; t++)
+    if (fown[t] == t) s += nf * fourierbytes(t);
+  return s;
+}
+
+// create the Fourier buffers of the storage plan
+//
+bool create_fourier(void) {
+  unsigned int err;
+  int t;
+
+  for (t = 0; t < AFB; t++) {
+    tb[t] = 0;
+    fb[t] = 0;
+  }
 
   for (t = 0; t < AFB; t++) {
+    if (fown[t] != t) continue;
+
     fprintf(logfile, "complex buffer %d\n", t);
     fflush(logfile);
 
+    glGenTextures(1, &tb[t]);
+    glGenFramebuffers(1, &fb[t]);
+    err = glGetError();
+    fprintf(logfile, "GenTextures err %d\n", err);
+    fflush(logfile);
+    if (err) return false;
+
     glBindTexture(ttd, tb[t]);
     err = glGetError();
     fprintf(logfile, "BindTexture err %d\n", err);
@@ -868,14 +1400,16 @@ bool create_buffers(void) {
       glTexParameterf(ttd, GL_TEXTURE_WRAP_R, GL_REPEAT);
     }
 
+    GLint ifmt = fourierfmt(t);
+    int c = fourierchannels(t);
+    GLenum fmt = c == 1 ? GL_RED : c == 4 ? GL_RGBA : GL_RG;
     if (dims == 1)
-      glTexImage1D(GL_TEXTURE_1D, 0, GL_RG32F, NX / 2 + 1, 0, GL_RG, GL_FLOAT,
-                   NULL);
+      glTexImage1D(GL_TEXTURE_1D, 0, ifmt, NX / 2 + 1, 0, fmt, GL_FLOAT, NULL);
     if (dims == 2)
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, NX / 2 + 1, NY, 0, GL_RG,
-                   GL_FLOAT, NULL);
+      glTexImage2D(GL_TEXTURE_2D, 0, ifmt, NX / 2 + 1, NY, 0, fmt, GL_FLOAT,
+                   NULL);
     if (dims == 3)
-      glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, NX / 2 + 1, NY, NZ, 0, GL_RG,
+      glTexImage3D(GL_TEXTURE_3D, 0, ifmt, NX / 2 + 1, NY, NZ, 0, fmt,
                    GL_FLOAT, NULL);
     err = glGetError();
     fprintf(logfile, "TexImage err %d\n", err);
@@ -894,7 +1428,9 @@ bool create_buffers(void) {
     if (dims == 2)
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_2D, tb[t], 0);
-    if (dims == 3)
+    if (dims == 3 && layered)
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tb[t], 0);
+    if (dims == 3 && !layered)
       glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_3D, tb[t], 0, 0);
     err = glGetError();
@@ -908,24 +1444,83 @@ bool create_buffers(void) {
     if (err != GL_FRAMEBUFFER_COMPLETE) return false;
   }
 
-  // real buffers
+  for (t = 0; t < AFB; t++)
+    if (fown[t] >= 0 && fown[t] != t) {
+      tb[t] = tb[fown[t]];
+      fb[t] = fb[fown[t]];
+      fprintf(logfile, "complex buffer %d uses %d\n", t, fown[t]);
+      fflush(logfile);
+    }
 
-  glGenTextures(ARB, &tr[0]);
-  err = glGetError();
-  fprintf(logfile, "GenTextures err %d\n", err);
-  fflush(logfile);
-  if (err) return false;
+  return true;
+}
+
+// delete the Fourier buffers
+//
+void delete_fourier(void) {
+  unsigned int err;
+  int t;
 
-  glGenFramebuffers(ARB, &fr[0]);
+  glBindTexture(ttd, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  for (t = 0; t < AFB; t++)
+    if (fown[t] == t) {
+      glDeleteTextures(1, &tb[t]);
+      glDeleteFramebuffers(1, &fb[t]);
+    }
+  for (t = 0; t < AFB; t++) {
+    tb[t] = 0;
+    fb[t] = 0;
+  }
   err = glGetError();
-  fprintf(logfile, "GenFramebuffers err %d\n", err);
+  fprintf(logfile, "delete Fourier buffers err %d\n", err);
   fflush(logfile);
-  if (err) return false;
+}
+
+// create real and Fourier buffers (see planbuffers)
+//
+bool create_buffers(void) {
+  unsigned int err;
+  int t, s, eb;
+
+  if (dims == 1) {
+    fprintf(logfile, "create buffers 1D %d\n", NX);
+    fflush(logfile);
+  } else if (dims == 2) {
+    fprintf(logfile, "create buffers 2D %d %d\n", NX, NY);
+    fflush(logfile);
+  } else  // dims==3
+  {
+    fprintf(logfile, "create buffers 3D %d %d %d\n", NX, NY, NZ);
+    fflush(logfile);
+  }
+
+  planbuffers();
+
+  // Fourier (complex) buffers
+
+  if (!create_fourier()) return false;
+
+  // real buffers
 
   for (t = 0; t < ARB; t++) {
+    tr[t] = 0;
+    fr[t] = 0;
+  }
+
+  for (t = 0; t < ARB; t++) {
+    if (rown[t] != t) continue;
+
     fprintf(logfile, "real buffer %d\n", t);
     fflush(logfile);
 
+    glGenTextures(1, &tr[t]);
+    glGenFramebuffers(1, &fr[t]);
+    err = glGetError();
+    fprintf(logfile, "GenTextures err %d\n", err);
+    fflush(logfile);
+    if (err) return false;
+
     glBindTexture(ttd, tr[t]);
     err = glGetError();
     fprintf(logfile, "BindTexture err %d\n", err);
@@ -942,13 +1537,13 @@ bool create_buffers(void) {
       glTexParameterf(ttd, GL_TEXTURE_WRAP_R, GL_REPEAT);
     }
 
+    GLint ifmt = realfmt(t);
     if (dims == 1)
-      glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, NX, 0, GL_RED, GL_FLOAT, NULL);
+      glTexImage1D(GL_TEXTURE_1D, 0, ifmt, NX, 0, GL_RED, GL_FLOAT, NULL);
     if (dims == 2)
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, GL_RED, GL_FLOAT,
-                   NULL);
+      glTexImage2D(GL_TEXTURE_2D, 0, ifmt, NX, NY, 0, GL_RED, GL_FLOAT, NULL);
     if (dims == 3)
-      glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, NX, NY, NZ, 0, GL_RED, GL_FLOAT,
+      glTexImage3D(GL_TEXTURE_3D, 0, ifmt, NX, NY, NZ, 0, GL_RED, GL_FLOAT,
                    NULL);
     err = glGetError();
     fprintf(logfile, "TexImage err %d\n", err);
@@ -967,7 +1562,9 @@ bool create_buffers(void) {
     if (dims == 2)
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_2D, tr[t], 0);
-    if (dims == 3)
+    if (dims == 3 && layered)
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tr[t], 0);
+    if (dims == 3 && !layered)
       glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                              GL_TEXTURE_3D, tr[t], 0, 0);
     err = glGetError();
@@ -981,6 +1578,14 @@ bool create_buffers(void) {
     if (err != GL_FRAMEBUFFER_COMPLETE) return false;
   }
 
+  for (t = 0; t < ARB; t++)
+    if (rown[t] != t) {
+      tr[t] = tr[rown[t]];
+      fr[t] = fr[rown[t]];
+      fprintf(logfile, "real buffer %d uses %d\n", t, rown[t]);
+      fflush(logfile);
+    }
+
   // FFT plan texture
 
   glGenTextures((BX - 1 + 2) * 2, &planx[0][0]);
@@ -1053,7 +1658,33 @@ bool create_buffers(void) {
     }
   }
 
-  fprintf(logfile, "all buffers ok\n");
+  // twiddle tables for the compute shader FFT
+
+  glGenTextures(3, &twid[0]);
+  for (t = 0; t < 3; t++) {
+    glBindTexture(GL_TEXTURE_1D, twid[t]);
+    err = glGetError();
+    fprintf(logfile, "BindTexture err %d\n", err);
+    fflush(logfile);
+    if (err) return false;
+
+    glTexParameterf(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA32F, t == 0 ? NX : t == 1 ? NY : NZ,
+                 0, GL_RGBA, GL_FLOAT, NULL);
+    err = glGetError();
+    fprintf(logfile, "TexImage err %d\n", err);
+    fflush(logfile);
+    if (err) return false;
+  }
+
+  // quads of the shader passes
+
+  if (!makepassquads()) return false;
+  newsteps();
+
+  fprintf(logfile, "all buffers ok, %.1f MB\n", bufferbytes() / 1048576.0);
   fflush(logfile);
 
   return true;
@@ -1063,6 +1694,7 @@ bool create_buffers(void) {
 //
 void delete_buffers(void) {
   unsigned int err;
+  int t;
 
   fprintf(logfile, "delete buffers\n");
   fflush(logfile);
@@ -1072,12 +1704,10 @@ void delete_buffers(void) {
   fprintf(logfile, "BindTexture 0 err %d\n", err);
   fflush(logfile);
 
-  glDeleteTextures(AFB, &tb[0]);
-  err = glGetError();
-  fprintf(logfile, "DeleteTextures err %d\n", err);
-  fflush(logfile);
+  delete_fourier();
 
-  glDeleteTextures(ARB, &tr[0]);
+  for (t = 0; t < ARB; t++)
+    if (rown[t] == t) glDeleteTextures(1, &tr[t]);
   err = glGetError();
   fprintf(logfile, "DeleteTextures err %d\n", err);
   fflush(logfile);
@@ -1100,34 +1730,202 @@ void delete_buffers(void) {
     fflush(logfile);
   }
 
+  glDeleteTextures(3, &twid[0]);
+  err = glGetError();
+  fprintf(logfile, "DeleteTextures err %d\n", err);
+  fflush(logfile);
+
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   err = glGetError();
   fprintf(logfile, "BindFramebuffer 0 err %d\n", err);
   fflush(logfile);
 
-  glDeleteFramebuffers(AFB, &fb[0]);
+  for (t = 0; t < ARB; t++)
+    if (rown[t] == t) glDeleteFramebuffers(1, &fr[t]);
+  for (t = 0; t < ARB; t++) {
+    tr[t] = 0;
+    fr[t] = 0;
+  }
   err = glGetError();
   fprintf(logfile, "DeleteFramebuffers err %d\n", err);
   fflush(logfile);
 
-  glDeleteFramebuffers(ARB, &fr[0]);
+  glDeleteVertexArrays(1, &passvao);
+  glDeleteBuffers(1, &passvbo);
   err = glGetError();
-  fprintf(logfile, "DeleteFramebuffers err %d\n", err);
+  fprintf(logfile, "DeleteBuffers err %d\n", err);
+  fflush(logfile);
+
+  if (spfb) {
+    delete_render_buffer();
+    spfb = 0;
+    sptb = 0;
+  }
+}
+
+// time the following passes as class c (-1 = stop timing) with bytes read and
+// written, consecutive passes of one class are one segment
+//
+void timerclass(int c, long bytes) {
+  if (tcur < 0) return;
+  timerframe *f = &tframes[tcur];
+
+  if (c == tclass) {
+    f->bytes[f->n - 1] += bytes;
+    return;
+  }
+  if (tclass >= 0) glEndQuery(GL_TIME_ELAPSED);
+  tclass = -1;
+  if (c < 0 || f->n >= TQMAX) return;
+
+  if (f->qel[f->n] == 0) {
+    glGenQueries(1, &f->qel[f->n]);
+    glGenQueries(1, &f->qts[f->n]);
+  }
+  glQueryCounter(f->qts[f->n], GL_TIMESTAMP);
+  glBeginQuery(GL_TIME_ELAPSED, f->qel[f->n]);
+  f->cls[f->n] = c;
+  f->bytes[f->n] = bytes;
+  f->n++;
+  tclass = c;
+}
+
+// take the results of frame f into tms, tbytes and the trace
+//
+void timerresults(timerframe *f) {
+  double ms[TCLASSES] = {0}, bytes[TCLASSES] = {0};
+  GLuint64 el, ts, t0 = 0, t1 = 0;
+  int i, c;
+
+  for (i = 0; i < f->n; i++) {
+    glGetQueryObjectui64v(f->qel[i], GL_QUERY_RESULT, &el);
+    glGetQueryObjectui64v(f->qts[i], GL_QUERY_RESULT, &ts);
+    ms[f->cls[i]] += el / 1e6;
+    bytes[f->cls[i]] += f->bytes[i];
+    if (i == 0) t0 = ts;
+    t1 = ts + el;
+
+    if (tracefile) {
+      if (tracebase == 0) tracebase = ts;
+      fprintf(tracefile,
+              ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,"
+              "\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%ld,"
+              "\"MB\":%.3f,\"GB/s\":%.2f}}",
+              tclassname[f->cls[i]], (ts - tracebase) / 1e3, el / 1e3, f->nr,
+              f->bytes[i] / 1e6, el ? f->bytes[i] / (double)el : 0.0);
+    }
+  }
+
+  if (tracefile && f->n > 0) {
+    fprintf(tracefile,
+            ",\n{\"name\":\"frame\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,"
+            "\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%ld,"
+            "\"steps\":%d}}",
+            (t0 - tracebase) / 1e3, (t1 - t0) / 1e3, f->nr, f->steps);
+    if (++traceframes >= TRACEFRAMES) {
+      fprintf(tracefile, "\n]\n");
+      fclose(tracefile);
+      tracefile = 0;
+      fprintf(logfile, "trace written, %ld frames\n", traceframes);
+      fflush(logfile);
+    }
+  }
+
+  for (c = 0; c < TCLASSES; c++) {
+    tms[c] = 0.9 * tms[c] + 0.1 * ms[c];
+    tbytes[c] = 0.9 * tbytes[c] + 0.1 * bytes[c];
+  }
+}
+
+// read the timer results of the frames the GPU is done with, oldest first,
+// without waiting
+//
+void timerpoll(void) {
+  for (long nr = tframenr - TFRAMES; nr < tframenr; nr++) {
+    if (nr < 0) continue;
+    timerframe *f = &tframes[nr % TFRAMES];
+    if (!f->pending) continue;
+
+    if (f->n > 0) {
+      GLuint done = 0;
+      glGetQueryObjectuiv(f->qel[f->n - 1], GL_QUERY_RESULT_AVAILABLE, &done);
+      if (!done) break;
+      timerresults(f);
+    }
+    f->pending = false;
+  }
+}
+
+// close the open segment of the timed frame
+//
+void timerframeend(void) {
+  if (tcur < 0) return;
+  timerclass(-1, 0);
+  tframes[tcur].steps = framesteps;
+  tframes[tcur].pending = true;
+  tcur = -1;
+}
+
+// at the start of a frame: take the results of older frames and time this
+// one if the timers are on, it's skipped if its queries are still in flight
+//
+void timerframebegin(void) {
+  timerframeend();
+  timerpoll();
+
+  timers = timerok && (timing || tracefile);
+  if (!timers) return;
+
+  timerframe *f = &tframes[tframenr % TFRAMES];
+  if (f->pending) return;
+  f->n = 0;
+  f->nr = tframenr++;
+  tcur = f - tframes;
+}
+
+// open the Chrome trace file (about:tracing, ui.perfetto.dev) named in
+// SMOOTHLIFE_TRACE, it gets the GPU passes of the next TRACEFRAMES frames
+//
+void timerstart(void) {
+  const char *name = getenv("SMOOTHLIFE_TRACE");
+
+  if (name == 0 || *name == 0 || !timerok) return;
+  tracefile = fopen(name, "w");
+  if (tracefile == 0) return;
+  fprintf(tracefile, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"args\":{\"name\":\"SmoothLife GPU\"}}");
+  fprintf(logfile, "trace %s\n", name);
   fflush(logfile);
 }
 
-// coordinates for the 3D cube
+// close the trace and delete the queries (program end)
 //
-int cube[6][4][3] = {{{1, 1, -1}, {-1, 1, -1}, {-1, 1, 1}, {1, 1, 1}},
-                     {{1, -1, 1}, {-1, -1, 1}, {-1, -1, -1}, {1, -1, -1}},
-                     {{1, 1, 1}, {-1, 1, 1}, {-1, -1, 1}, {1, -1, 1}},
-                     {{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}},
-                     {{-1, 1, 1}, {-1, 1, -1}, {-1, -1, -1}, {-1, -1, 1}},
-                     {{1, 1, -1}, {1, 1, 1}, {1, -1, 1}, {1, -1, -1}}};
+void timerstop(void) {
+  int i, t;
+
+  if (tcur >= 0) {
+    timerclass(-1, 0);
+    tcur = -1;
+  }
+  if (tracefile) {
+    fprintf(tracefile, "\n]\n");
+    fclose(tracefile);
+    tracefile = 0;
+  }
+  for (t = 0; t < TFRAMES; t++)
+    for (i = 0; i < TQMAX; i++)
+      if (tframes[t].qel[i]) {
+        glDeleteQueries(1, &tframes[t].qel[i]);
+        glDeleteQueries(1, &tframes[t].qts[i]);
+      }
+  memset(tframes, 0, sizeof(tframes));
+}
 
 // draw the buffer
 //
 void drawa(int a) {
+  timerclass(TDRAW, (long)SX * SY * 8);  // one texel in, one pixel out
+
   if (dims == 1) {
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -1147,18 +1945,13 @@ void drawa(int a) {
     glDisable(GL_TEXTURE_1D);
 
     glUseProgram(shader_draw);
-    glUniform1i(glGetUniformLocation(shader_draw, "tex0"), 0);
+    glUniform1i(loc_tex0, 0);
     glUniform1f(loc_colscheme, (float)colscheme);
     glUniform1f(loc_phase, (float)phase);
 
     glDisable(GL_DEPTH_TEST);
 
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, fx);
-    glVertex2d(0, ypos + 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, fx + 1);
-    glVertex2d(qx, ypos + 0.5);
-    glEnd();
+    drawunitquad(GL_LINES, 0, ypos + 0.5, qx, 1, fx, 0, 1);
 
     glUseProgram(0);
 
@@ -1181,22 +1974,13 @@ void drawa(int a) {
     glDisable(GL_TEXTURE_2D);
 
     glUseProgram(shader_draw);
-    glUniform1i(glGetUniformLocation(shader_draw, "tex0"), 0);
+    glUniform1i(loc_tex0, 0);
     glUniform1f(loc_colscheme, (float)colscheme);
     glUniform1f(loc_phase, (float)phase);
 
     glDisable(GL_DEPTH_TEST);
 
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, fx, fy);
-    glVertex2i(ox, oy);
-    glMultiTexCoord2d(GL_TEXTURE0, fx + 1, fy);
-    glVertex2i(ox + qx, oy);
-    glMultiTexCoord2d(GL_TEXTURE0, fx + 1, fy + 1);
-    glVertex2i(ox + qx, oy + qy);
-    glMultiTexCoord2d(GL_TEXTURE0, fx, fy + 1);
-    glVertex2i(ox, oy + qy);
-    glEnd();
+    drawunitquad(GL_QUADS, ox, oy, qx, qy, fx, fy, 1);
 
     glUseProgram(0);
 
@@ -1213,15 +1997,15 @@ void drawa(int a) {
     glEnable(GL_TEXTURE_3D);
     glBindTexture(GL_TEXTURE_3D, tr[a]);
     glUseProgram(shader_draw);
-    glUniform1i(glGetUniformLocation(shader_draw, "tex0"), 0);
+    glUniform1i(loc_tex0, 0);
 
-    glUniform1f(glGetUniformLocation(shader_draw, "fx"), (float)fx);
-    glUniform1f(glGetUniformLocation(shader_draw, "fy"), (float)fy);
-    glUniform1f(glGetUniformLocation(shader_draw, "fz"), (float)fz);
+    glUniform1f(loc_fx, (float)fx);
+    glUniform1f(loc_fy, (float)fy);
+    glUniform1f(loc_fz, (float)fz);
 
-    glUniform1f(glGetUniformLocation(shader_draw, "nx"), (float)NX);
-    glUniform1f(glGetUniformLocation(shader_draw, "ny"), (float)NY);
-    glUniform1f(glGetUniformLocation(shader_draw, "nz"), (float)NZ);
+    glUniform1f(loc_nx, (float)NX);
+    glUniform1f(loc_ny, (float)NY);
+    glUniform1f(loc_nz, (float)NZ);
 
     glUniform1f(loc_colscheme, (float)colscheme);
     glUniform1f(loc_phase, (float)phase);
@@ -1247,14 +2031,9 @@ void drawa(int a) {
 
     wi += dw;
 
-    for (int s = 0; s < 6; s++) {
-      glBegin(GL_QUADS);
-      for (int c = 0; c < 4; c++) {
-        glVertex3d(NX / 2 * cube[s][c][0], NY / 2 * cube[s][c][1],
-                   NZ / 2 * cube[s][c][2]);
-      }
-      glEnd();
-    }
+    glBindVertexArray(passvao);
+    glDrawArrays(GL_QUADS, quads_cube, 6 * 4);
+    glBindVertexArray(0);
 
     glPopMatrix();
 
@@ -1321,207 +2100,412 @@ double pnorm(double x, double y, double z, double p) {
   return pow(pow(fabs(x), p) + pow(fabs(y), p) + pow(fabs(z), p), 1.0 / p);
 }
 
-// make the disk and ring kernel (real) buffers
+// p of the norm the kernel is round in (0.5 star, 1 diamond, 2 round, 20
+// almost a box), 2 takes the values from a table by squared distance
 //
-void makekernel(int kr, int kd) {
-  int ix, iy, iz, x, y, z;
-  double l, n, m;
-  float *ar, *ad;
-  int Ra;
-  double ri, bb;
-
-  ad = (float *)calloc(NX * NY, sizeof(float));
-  if (ad == 0) {
-    fprintf(logfile, "ad failed\n");
-    fflush(logfile);
-    return;
+const double KERNELP = 2.0;
+
+// radii of the kernel being built and the table of its values by squared
+// distance (KERNELP 2) for the kernelrow tasks
+//
+struct kernelrows {
+  kernelbox *b;
+  double ra, ri, bb;
+  double *tab;  // ring and disk value of squared distance m at tab[m*2]
+  double *kr, *kd;  // area of each row
+};
+
+// ring (n) and disk (m) kernel value at distance l
+//
+void kernelpoint(double l, double ra, double ri, double bb, double &n,
+                 double &m) {
+  m = 1 - func_kernel(l, ri, bb);
+  n = func_kernel(l, ri, bb) * (1 - func_kernel(l, ra, bb));
+}
+
+// compute row task (y and z in the box) of a kernel box
+//
+void kernelrow(void *ctx, int task, int thread) {
+  kernelrows &k = *(kernelrows *)ctx;
+  kernelbox &b = *k.b;
+  int y = b.lo[1] + task % b.n[1];
+  int z = b.lo[2] + task / b.n[1];
+  float *ar = b.ar + (long)task * b.n[0];
+  float *ad = b.ad + (long)task * b.n[0];
+  double kr = 0.0, kd = 0.0;
+  double n, m;
+  int i, x;
+
+  for (i = 0; i < b.n[0]; i++) {
+    x = b.lo[0] + i;
+    if (k.tab) {
+      long d = (long)x * x + (long)y * y + (long)z * z;
+      n = k.tab[d * 2];
+      m = k.tab[d * 2 + 1];
+    } else {
+      kernelpoint(pnorm(x, y, z, KERNELP), k.ra, k.ri, k.bb, n, m);
+    }
+
+    /*
+    // angle dependent kernel
+    double w;
+    w = atan2 (x, y);
+    n *= 0.5*sin(6*w)+0.5;
+    */
+
+    /*
+    // gauss kernel (profile is a gaussian instead of flat)
+    const double mc = 2;
+    const double nc = 4;
+
+    double r;
+
+    r = l/(ri/mc);
+    m = exp(-r*r);
+
+    r = l-(ra+ri)/2;
+    r /= (ra-ri)/nc;
+    n = exp(-r*r);
+    */
+
+    ad[i] = (float)m;
+    ar[i] = (float)n;
+    kr += n;
+    kd += m;
   }
 
-  ar = (float *)calloc(NX * NY, sizeof(float));
-  if (ar == 0) {
-    fprintf(logfile, "ar failed\n");
-    fflush(logfile);
-    return;
+  k.kr[task] = kr;
+  k.kd[task] = kd;
+}
+
+// build the kernel box of a dims dimensional nx*ny*nz grid with radii ra, rr,
+// rb, only the box around the kernel's support is computed (its rows spread
+// over the CPU threads if threads is set, the prefetch thread builds without
+// them), false if out of memory
+//
+bool kernelboxmake(kernelbox &b, int dims, int nx, int ny, int nz, double ra,
+                   double rr, double rb, bool threads) {
+  int size[3] = {nx, ny, nz};
+  kernelrows k;
+  int d, t;
+
+  k.b = &b;
+  k.ra = ra;
+  k.ri = ra / rr;
+  k.bb = ra / rb;
+
+  // Ra = (int)(ra * 2);  // func_smooth has no bounded support
+  int Ra = (int)(ra + k.bb / 2 + 1.0);
+
+  memset(&b, 0, sizeof(b));
+  b.dims = dims;
+  b.nx = nx;
+  b.ny = ny;
+  b.nz = nz;
+  long m = 0;  // max squared distance
+  for (d = 0; d < 3; d++) {
+    b.lo[d] = 0;
+    b.n[d] = 1;
+    if (d < dims) {
+      // index i is x = i below size/2, i - size above
+      int lo = -(size[d] - size[d] / 2), hi = size[d] / 2 - 1;
+      b.lo[d] = lo > -Ra ? lo : -Ra;
+      b.n[d] = (hi < Ra ? hi : Ra) - b.lo[d] + 1;
+      m += (long)b.lo[d] * b.lo[d];
+    }
+  }
+
+  int rows = b.n[1] * b.n[2];
+  long s = (long)b.n[0] * rows;
+  b.ar = (float *)calloc(s, sizeof(float));
+  b.ad = (float *)calloc(s, sizeof(float));
+  k.kr = (double *)calloc(rows, sizeof(double));
+  k.kd = (double *)calloc(rows, sizeof(double));
+  k.tab = KERNELP == 2.0 ? (double *)calloc((m + 1) * 2, sizeof(double)) : 0;
+  if (b.ar == 0 || b.ad == 0 || k.kr == 0 || k.kd == 0 ||
+      (KERNELP == 2.0 && k.tab == 0)) {
+    free(k.kr);
+    free(k.kd);
+    free(k.tab);
+    free(b.ar);
+    free(b.ad);
+    b.ar = b.ad = 0;
+    return false;
   }
 
-  ri = ra / rr;
-  bb = ra / rb;
+  if (k.tab)
+    for (long l = 0; l <= m; l++)
+      kernelpoint(sqrt((double)l), k.ra, k.ri, k.bb, k.tab[l * 2],
+                  k.tab[l * 2 + 1]);
 
-  // Ra = (int)(ra+bb/2+1.0);
-  Ra = (int)(ra * 2);
+  if (threads)
+    parallel_for(rows, kernelrow, &k);
+  else
+    for (t = 0; t < rows; t++) kernelrow(&k, t, 0);
 
-  kflr = 0.0;
-  kfld = 0.0;
+  // in row order, so the areas don't depend on the number of threads
+  for (t = 0; t < rows; t++) {
+    b.kr += k.kr[t];
+    b.kd += k.kd[t];
+  }
 
-  for (iz = 0; iz < NZ; iz++) {
-    memset(ad, 0, NX * NY * sizeof(float));
-    memset(ar, 0, NX * NY * sizeof(float));
-    if (dims > 2) {
-      if (iz < NZ / 2)
-        z = iz;
-      else
-        z = iz - NZ;
-    } else {
-      z = 0;
-    }
-    if (z >= -Ra && z <= Ra) {
-      for (iy = 0; iy < NY; iy++) {
-        if (dims > 1) {
-          if (iy < NY / 2)
-            y = iy;
-          else
-            y = iy - NY;
-        } else {
-          y = 0;
-        }
-        if (y >= -Ra && y <= Ra) {
-          for (ix = 0; ix < NX; ix++) {
-            if (ix < NX / 2)
-              x = ix;
-            else
-              x = ix - NX;
-            if (x >= -Ra && x <= Ra) {
-              // l = pnorm (x,y,z,0.5);
-              // l = pnorm (x,y,z,1);
-              l = pnorm(x, y, z, 2);
-              // l = pnorm (x,y,z,20);
-
-              m = 1 - func_kernel(l, ri, bb);
-              n = func_kernel(l, ri, bb) * (1 - func_kernel(l, ra, bb));
-
-              /*
-              // angle dependent kernel
-              double w;
-              w = atan2 (x, y);
-              n *= 0.5*sin(6*w)+0.5;
-              */
-
-              /*
-              // gauss kernel (profile is a gaussian instead of flat)
-              const double mc = 2;
-              const double nc = 4;
-
-              double r;
-
-              r = l/(ri/mc);
-              m = exp(-r*r);
-
-              r = l-(ra+ri)/2;
-              r /= (ra-ri)/nc;
-              n = exp(-r*r);
-              */
-
-              *(ad + iy * NX + ix) = (float)m;
-              *(ar + iy * NX + ix) = (float)n;
-              kflr += n;
-              kfld += m;
-            }  // if ix
-          }    // for ix
-        }      // if iy
-      }        // for iy
-    }          // if iz
-
-    if (dims == 1) {
-      glBindTexture(GL_TEXTURE_1D, tr[kd]);
-      glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX, GL_RED, GL_FLOAT, ad);
-
-      glBindTexture(GL_TEXTURE_1D, tr[kr]);
-      glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX, GL_RED, GL_FLOAT, ar);
-    } else if (dims == 2) {
-      glBindTexture(GL_TEXTURE_2D, tr[kd]);
-      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, GL_RED, GL_FLOAT, ad);
-
-      glBindTexture(GL_TEXTURE_2D, tr[kr]);
-      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, GL_RED, GL_FLOAT, ar);
-    } else  // dims==3
-    {
-      glBindTexture(GL_TEXTURE_3D, tr[kd]);
-      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, iz, NX, NY, 1, GL_RED, GL_FLOAT,
-                      ad);
+  free(k.kr);
+  free(k.kd);
+  free(k.tab);
+  return true;
+}
+
+void kernelboxfree(kernelbox &b) {
+  free(b.ar);
+  free(b.ad);
+  b.ar = b.ad = 0;
+}
 
-      glBindTexture(GL_TEXTURE_3D, tr[kr]);
-      glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, iz, NX, NY, 1, GL_RED, GL_FLOAT,
-                      ar);
+// clear real buffer t and put box a of b into it, the box wraps around at the
+// buffer edges, so it goes up in up to 2 parts per dimension
+//
+void kernelupload(const kernelbox &b, const float *a, int t) {
+  int size[3] = {b.nx, b.ny, b.nz};
+  int part[3][2][3];  // first box index, buffer offset and length of the
+                      // negative and positive coordinates per dimension
+  int d, h, ix, iy, iz;
+
+  glBindTexture(ttd, tr[t]);
+  if (clearok)
+    glClearTexImage(tr[t], 0, GL_RED, GL_FLOAT, 0);
+  else {
+    float *zero = (float *)calloc((long)b.nx * b.ny, sizeof(float));
+    if (zero == 0) {
+      fprintf(logfile, "kernel zero slice failed\n");
+      fflush(logfile);
+      return;
     }
-  }  // for iz
+    for (iz = 0; iz < b.nz; iz++) {
+      if (b.dims == 1)
+        glTexSubImage1D(GL_TEXTURE_1D, 0, 0, b.nx, GL_RED, GL_FLOAT, zero);
+      if (b.dims == 2)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, b.nx, b.ny, GL_RED, GL_FLOAT,
+                        zero);
+      if (b.dims == 3)
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, iz, b.nx, b.ny, 1, GL_RED,
+                        GL_FLOAT, zero);
+    }
+    free(zero);
+  }
+
+  for (d = 0; d < 3; d++) {
+    int lo = b.lo[d], hi = b.lo[d] + b.n[d] - 1;
+    part[d][0][0] = 0;  // x from lo to -1
+    part[d][0][1] = size[d] + lo;
+    part[d][0][2] = lo < 0 ? (hi < 0 ? hi : -1) - lo + 1 : 0;
+    part[d][1][0] = lo < 0 ? -lo : 0;  // x from 0 (or lo) to hi
+    part[d][1][1] = lo < 0 ? 0 : lo;
+    part[d][1][2] = hi >= 0 ? hi - (lo < 0 ? 0 : lo) + 1 : 0;
+  }
+
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, b.n[0]);
+  glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, b.n[1]);
+  for (h = 0; h < 8; h++) {
+    int *px = part[0][h & 1], *py = part[1][h >> 1 & 1],
+        *pz = part[2][h >> 2 & 1];
+    if (px[2] == 0 || py[2] == 0 || pz[2] == 0) continue;
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, px[0]);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, py[0]);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, pz[0]);
+    ix = px[1];
+    iy = py[1];
+    iz = pz[1];
+    if (b.dims == 1)
+      glTexSubImage1D(GL_TEXTURE_1D, 0, ix, px[2], GL_RED, GL_FLOAT, a);
+    if (b.dims == 2)
+      glTexSubImage2D(GL_TEXTURE_2D, 0, ix, iy, px[2], py[2], GL_RED,
+                      GL_FLOAT, a);
+    if (b.dims == 3)
+      glTexSubImage3D(GL_TEXTURE_3D, 0, ix, iy, iz, px[2], py[2], pz[2],
+                      GL_RED, GL_FLOAT, a);
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+}
+
+// make the disk and ring kernel (real) buffers
+//
+void makekernel(int kr, int kd) {
+  kernelbox b;
 
-  free(ar);
-  free(ad);
+  if (!kernelboxmake(b, dims, NX, NY, NZ, ra, rr, rb, true)) {
+    fprintf(logfile, "kernel box failed\n");
+    fflush(logfile);
+    return;
+  }
+  kflr = b.kr;
+  kfld = b.kd;
+  kernelupload(b, b.ad, kd);
+  kernelupload(b, b.ar, kr);
+  kernelboxfree(b);
 
   fprintf(
       logfile,
       "ra=%lf rr=%lf rb=%lf ri=%lf bb=%lf kflr=%lf kfld=%lf kflr/kfld=%lf\n",
-      ra, rr, rb, ri, bb, kflr, kfld, kflr / kfld);
+      ra, rr, rb, ra / rr, ra / rb, kflr, kfld, kflr / kfld);
   fflush(logfile);
+
+  kernelreal = true;
+  newsteps();  // the recorded kernel multiply has the old kflr, kfld
 }
 
-// make FFT plan buffers
+// split n into FFT stages with radix maxr (8 or 4, powers of 2 done as few
+// passes as possible), 2, 3, 5, 7 (in this order) and the remaining prime
+// factors, radix[1..] gets the radix of each stage, returns the number of
+// stages (0 for n=1)
+//
+int fft_radices(int n, int *radix, int maxr) {
+  static const int small[4] = {2, 3, 5, 7};
+  int b = 0;
+
+  for (int r = maxr; r > 2; r /= 2)
+    while (n % r == 0 && b < BMAX - 2) {
+      radix[++b] = r;
+      n /= r;
+    }
+  for (int t = 0; t < 4; t++)
+    while (n % small[t] == 0 && b < BMAX - 2) {
+      radix[++b] = small[t];
+      n /= small[t];
+    }
+  for (int f = 11; n > 1 && b < BMAX - 2; f += 2)
+    while (n % f == 0 && b < BMAX - 2) {
+      radix[++b] = f;
+      n /= f;
+    }
+  return b;
+}
+
+// n is a valid buffer size, even (for the real x transform) and with FFT
+// stages of radix 2, 3, 5 or 7 only
 //
+bool smoothsize(int n) {
+  if (n < 2 || n % 2) return false;
+  while (n % 2 == 0) n /= 2;
+  while (n % 3 == 0) n /= 3;
+  while (n % 5 == 0) n /= 5;
+  while (n % 7 == 0) n /= 7;
+  return n == 1;
+}
+
+// next larger (dir=1) or smaller (dir=-1) buffer size after n with
+// smoothsize, n itself if there is none between lo and hi
+//
+int nextsize(int n, int dir, int lo, int hi) {
+  int m = n + dir;
+  while (m >= lo && m <= hi && !smoothsize(m)) m += dir;
+  if (m < lo || m > hi) return n;
+  return m;
+}
 
-int bitreverse(int x, int b) {
-  int c, t;
+// mixed radix decimation in time FFT, input index of position x of the first
+// stage (digits of x reversed, for radix 2 only the bit reversal)
+//
+int digitreverse(int x, int n, const int *radix, int b) {
+  int c = 0, l = 1;
 
-  c = 0;
-  for (t = 0; t < b; t++) {
-    c = (c << 1) | ((x >> t) & 1);
+  for (int k = 1; k <= b; k++) {
+    int t = (x / l) % radix[k];
+    l *= radix[k];
+    c += t * (n / l);
   }
   return c;
 }
 
+// plan for stage eb of a length n FFT with b stages of radix[1..b], texture
+// coordinates are for a texture of width w, for each output x
+// r: coordinate of the first source, g: of the second (the r sources of a
+// radix r stage are equally spaced), ba: twiddle for the second source (the
+// t-th source gets the t-th power)
+//
+void fft_planstage(float *p, int n, int w, const int *radix, int b, int eb,
+                   int si) {
+  int r = radix[eb];
+  int l = 1;
+  for (int k = 1; k <= eb; k++) l *= radix[k];
+  int lp = l / r;
+
+  for (int x = 0; x < n; x++) {
+    int base = x - x % l;
+    int j = x % l;
+    int m = j % lp;
+    int s0, s1;
+    if (eb == 1) {
+      s0 = digitreverse(base, n, radix, b);
+      s1 = s0 + n / r;
+    } else {
+      s0 = base + m;
+      s1 = base + m + lp;
+    }
+    double tw = si * PI * j / l;
+    *(p + 4 * x + 0) = (s0 + 0.5f) / (float)w;
+    *(p + 4 * x + 1) = (s1 + 0.5f) / (float)w;
+    *(p + 4 * x + 2) = (float)cos(tw);
+    *(p + 4 * x + 3) = (float)sin(tw);
+  }
+}
+
+// table for the compute shader FFT of length len into texture tex, W_n^k as
+// (cos, sin) for k < n in rg, the input index of position k (k < len) in b
+//
+void fft_twiddles(GLuint tex, int n, int len) {
+  float *p = (float *)calloc(4 * n, sizeof(float));
+  int radix[BMAX];
+  int b = fft_radices(len, radix, FFTCRADIX);
+
+  for (int k = 0; k < n; k++) {
+    *(p + 4 * k + 0) = (float)cos(PI * k / n);
+    *(p + 4 * k + 1) = (float)sin(PI * k / n);
+    if (k < len) *(p + 4 * k + 2) = (float)digitreverse(k, len, radix, b);
+  }
+  glBindTexture(GL_TEXTURE_1D, tex);
+  glTexSubImage1D(GL_TEXTURE_1D, 0, 0, n, GL_RGBA, GL_FLOAT, p);
+
+  free(p);
+}
+
+// make FFT plan buffers
+//
 void fft_planx(void) {
   float *p = (float *)calloc(4 * (NX / 2 + 1), sizeof(float));
 
   for (int s = 0; s <= 1; s++) {
     int si = s * 2 - 1;
     for (int eb = 0; eb <= BX - 1 + 1; eb++) {
-      for (int x = 0; x < NX / 2 + 1; x++) {
-        if (si == 1 && eb == 0) {
-          *(p + 4 * x + 0) = (x + 0.5f) / (float)(NX / 2 + 1);
-          *(p + 4 * x + 1) = (NX / 2 - x + 0.5f) / (float)(NX / 2 + 1);
-          double w = si * PI * (x / (double)NX + 0.25);
-          *(p + 4 * x + 2) = (float)cos(w);
-          *(p + 4 * x + 3) = (float)sin(w);
-        } else if (si == -1 && eb == BX) {
-          if (x == 0 || x == NX / 2) {
-            *(p + 4 * x + 0) = 0;
-            *(p + 4 * x + 1) = 0;
-          } else {
-            *(p + 4 * x + 0) = (x) / (float)(NX / 2);
-            *(p + 4 * x + 1) = (NX / 2 - x) / (float)(NX / 2);
-          }
-          double w = si * PI * (x / (double)NX + 0.25);
-          *(p + 4 * x + 2) = (float)cos(w);
-          *(p + 4 * x + 3) = (float)sin(w);
-        } else if (x < NX / 2) {
-          int l = 1 << eb;
-          int j = x % l;
-          double w = si * PI * j / l;
-          if (j < l / 2) {
-            if (eb == 1) {
-              *(p + 4 * x + 0) = bitreverse(x, BX - 1) / (float)(NX / 2);
-              *(p + 4 * x + 1) =
-                  bitreverse(x + l / 2, BX - 1) / (float)(NX / 2);
+      if (eb > 0 && eb < BX) {
+        fft_planstage(p, NX / 2, NX / 2 + 1, RX, BX - 1, eb, si);
+        *(p + 4 * (NX / 2) + 0) = 0;
+        *(p + 4 * (NX / 2) + 1) = 0;
+        *(p + 4 * (NX / 2) + 2) = 0;
+        *(p + 4 * (NX / 2) + 3) = 0;
+      } else {
+        for (int x = 0; x < NX / 2 + 1; x++) {
+          if (si == 1 && eb == 0) {
+            *(p + 4 * x + 0) = (x + 0.5f) / (float)(NX / 2 + 1);
+            *(p + 4 * x + 1) = (NX / 2 - x + 0.5f) / (float)(NX / 2 + 1);
+          } else if (si == -1 && eb == BX) {
+            if (x == 0 || x == NX / 2) {
+              *(p + 4 * x + 0) = 0.5f / (float)(NX / 2 + 1);
+              *(p + 4 * x + 1) = 0.5f / (float)(NX / 2 + 1);
             } else {
-              *(p + 4 * x + 0) = (x) / (float)(NX / 2);
-              *(p + 4 * x + 1) = (x + l / 2) / (float)(NX / 2);
+              *(p + 4 * x + 0) = (x + 0.5f) / (float)(NX / 2 + 1);
+              *(p + 4 * x + 1) = (NX / 2 - x + 0.5f) / (float)(NX / 2 + 1);
             }
           } else {
-            if (eb == 1) {
-              *(p + 4 * x + 0) =
-                  bitreverse(x - l / 2, BX - 1) / (float)(NX / 2);
-              *(p + 4 * x + 1) = bitreverse(x, BX - 1) / (float)(NX / 2);
-            } else {
-              *(p + 4 * x + 0) = (x - l / 2) / (float)(NX / 2);
-              *(p + 4 * x + 1) = (x) / (float)(NX / 2);
-            }
+            *(p + 4 * x + 0) = 0;
+            *(p + 4 * x + 1) = 0;
           }
+          double w = si * PI * (x / (double)NX + 0.25);
           *(p + 4 * x + 2) = (float)cos(w);
           *(p + 4 * x + 3) = (float)sin(w);
-        } else {
-          *(p + 4 * x + 0) = 0;
-          *(p + 4 * x + 1) = 0;
-          *(p + 4 * x + 2) = 0;
-          *(p + 4 * x + 3) = 0;
         }
       }
 
@@ -1530,6 +2514,8 @@ void fft_planx(void) {
     }
   }
 
+
+  fft_twiddles(twid[0], NX, NX / 2);
   free(p);
 }
 
@@ -1539,36 +2525,15 @@ void fft_plany(void) {
   for (int s = 0; s <= 1; s++) {
     int si = s * 2 - 1;
     for (int eb = 1; eb <= BY; eb++) {
-      for (int x = 0; x < NY; x++) {
-        int l = 1 << eb;
-        int j = x % l;
-        double w = si * PI * j / l;
-        if (j < l / 2) {
-          if (eb == 1) {
-            *(p + 4 * x + 0) = bitreverse(x, BY) / (float)NY;
-            *(p + 4 * x + 1) = bitreverse(x + l / 2, BY) / (float)NY;
-          } else {
-            *(p + 4 * x + 0) = (x) / (float)NY;
-            *(p + 4 * x + 1) = (x + l / 2) / (float)NY;
-          }
-        } else {
-          if (eb == 1) {
-            *(p + 4 * x + 0) = bitreverse(x - l / 2, BY) / (float)NY;
-            *(p + 4 * x + 1) = bitreverse(x, BY) / (float)NY;
-          } else {
-            *(p + 4 * x + 0) = (x - l / 2) / (float)NY;
-            *(p + 4 * x + 1) = (x) / (float)NY;
-          }
-        }
-        *(p + 4 * x + 2) = (float)cos(w);
-        *(p + 4 * x + 3) = (float)sin(w);
-      }
+      fft_planstage(p, NY, NY, RY, BY, eb, si);
 
       glBindTexture(GL_TEXTURE_1D, plany[eb][s]);
       glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NY, GL_RGBA, GL_FLOAT, p);
     }
   }
 
+
+  fft_twiddles(twid[1], NY, NY);
   free(p);
 }
 
@@ -1578,196 +2543,141 @@ void fft_planz(void) {
   for (int s = 0; s <= 1; s++) {
     int si = s * 2 - 1;
     for (int eb = 1; eb <= BZ; eb++) {
-      for (int x = 0; x < NZ; x++) {
-        int l = 1 << eb;
-        int j = x % l;
-        double w = si * PI * j / l;
-        if (j < l / 2) {
-          if (eb == 1) {
-            *(p + 4 * x + 0) = bitreverse(x, BZ) / (float)NZ;
-            *(p + 4 * x + 1) = bitreverse(x + l / 2, BZ) / (float)NZ;
-          } else {
-            *(p + 4 * x + 0) = (x) / (float)NZ;
-            *(p + 4 * x + 1) = (x + l / 2) / (float)NZ;
-          }
-        } else {
-          if (eb == 1) {
-            *(p + 4 * x + 0) = bitreverse(x - l / 2, BZ) / (float)NZ;
-            *(p + 4 * x + 1) = bitreverse(x, BZ) / (float)NZ;
-          } else {
-            *(p + 4 * x + 0) = (x - l / 2) / (float)NZ;
-            *(p + 4 * x + 1) = (x) / (float)NZ;
-          }
-        }
-        *(p + 4 * x + 2) = (float)cos(w);
-        *(p + 4 * x + 3) = (float)sin(w);
-      }
+      fft_planstage(p, NZ, NZ, RZ, BZ, eb, si);
 
       glBindTexture(GL_TEXTURE_1D, planz[eb][s]);
       glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NZ, GL_RGBA, GL_FLOAT, p);
     }
   }
 
+
+  fft_twiddles(twid[2], NZ, NZ);
   free(p);
 }
 
-// copy a real buffer to a Fourier buffer
+// set up pass p: program prog draws the quads from vertex first on into the
+// framebuffer fbo with texture att, viewport width vw, no inputs, no uniforms
 //
-void copybufferrc(int vo, int na) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, NX / 2 + 1, 0, NY, -NZ, NZ);
-  glViewport(0, 0, NX / 2 + 1, NY);
+void passinit(pass &p, GLuint prog, GLuint fbo, GLuint att, int vw,
+              int first) {
+  memset(&p, 0, sizeof(pass));
+  p.prog = prog;
+  p.fbo = fbo;
+  p.att = att;
+  p.vw = vw;
+  p.first = first;
+  p.iloc[0] = p.iloc[1] = p.iloc[2] = -1;
+  p.floc = -1;
+  p.cls = -1;
+}
 
-  glBindFramebuffer(GL_FRAMEBUFFER, fb[na]);
-  glUseProgram(shader_copybufferrc);
+// class of pass p for the timers, rd and wr bytes read and written per
+// fragment (texels of the inputs and the output, caches not counted)
+//
+void passcost(pass &p, int cls, int rd, int wr) {
+  p.cls = cls;
+  p.bytes = (long)p.vw * NY * NZ * (rd + wr);
+}
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(ttd, tr[vo]);
-  glUniform1i(glGetUniformLocation(shader_copybufferrc, "tex0"), 0);
+// texture tex with target on unit u as input of pass p
+//
+void passtex(pass &p, int u, GLenum target, GLuint tex) {
+  p.target[u] = target;
+  p.tex[u] = tex;
+}
 
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(ttd, tr[vo]);
-  glUniform1i(glGetUniformLocation(shader_copybufferrc, "tex1"), 1);
+// draw pass p, the pass vertex array must be bound (the textures are attached
+// to their framebuffers since create_buffers, layered 3D passes draw all
+// slices in one go and the vertex shader picks the slice from the vertex z,
+// else each slice is attached in turn)
+//
+void drawpass(const pass &p) {
+  int u, t;
+
+  timerclass(p.cls, p.bytes);
+  glViewport(0, 0, p.vw, NY);
+  glBindFramebuffer(GL_FRAMEBUFFER, p.fbo);
+  glUseProgram(p.prog);
+
+  for (u = 0; u < 3; u++)
+    if (p.tex[u]) {
+      glActiveTexture(GL_TEXTURE0 + u);
+      glBindTexture(p.target[u], p.tex[u]);
+    }
+  for (u = 0; u < 3; u++)
+    if (p.iloc[u] >= 0) glUniform1i(p.iloc[u], p.ival[u]);
+  if (p.floc >= 0) glUniform1f(p.floc, p.fval);
+  if (p.snmparas) {
+    glUniform1f(loc_dt, (float)dt);
+    glUniform1f(loc_b1, (float)b1);
+    glUniform1f(loc_b2, (float)b2);
+    glUniform1f(loc_d1, (float)d1);
+    glUniform1f(loc_d2, (float)d2);
+    glUniform1f(loc_sn, (float)sn);
+    glUniform1f(loc_sm, (float)sm);
+  }
 
-  if (dims == 1) {
-    glFramebufferTexture1D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_1D,
-                           tb[na], 0);
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, 0 - 1.0 / NX);
-    glMultiTexCoord1d(GL_TEXTURE1, 0 - 0.0 / NX);
-    glVertex2d(0, 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, 1 - 1.0 / NX);
-    glMultiTexCoord1d(GL_TEXTURE1, 1 - 0.0 / NX);
-    glVertex2d(NX / 2, 0.5);
-    glEnd();
-  } else if (dims == 2) {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           tb[na], 0);
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, 0 - 1.0 / NX, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 0 - 0.0 / NX, 0);
-    glVertex2i(0, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1 - 1.0 / NX, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 1 - 0.0 / NX, 0);
-    glVertex2i(NX / 2, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1 - 1.0 / NX, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 1 - 0.0 / NX, 1);
-    glVertex2i(NX / 2, NY);
-    glMultiTexCoord2d(GL_TEXTURE0, 0 - 1.0 / NX, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 0 - 0.0 / NX, 1);
-    glVertex2i(0, NY);
-    glEnd();
-  } else  // dims==3
-  {
-    for (int t = 0; t < NZ; t++) {
-      double l = (t + 0.5) / NZ;
+  if (dims == 3 && !layered) {
+    for (t = 0; t < NZ; t++) {
       glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                             GL_TEXTURE_3D, tb[na], 0, t);
-      glBegin(GL_QUADS);
-      glMultiTexCoord3d(GL_TEXTURE0, 0 - 1.0 / NX, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0 - 0.0 / NX, 0, l);
-      glVertex3i(0, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1 - 1.0 / NX, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1 - 0.0 / NX, 0, l);
-      glVertex3i(NX / 2, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1 - 1.0 / NX, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1 - 0.0 / NX, 1, l);
-      glVertex3i(NX / 2, NY, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 0 - 1.0 / NX, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0 - 0.0 / NX, 1, l);
-      glVertex3i(0, NY, t);
-      glEnd();
+                             GL_TEXTURE_3D, p.att, 0, t);
+      glDrawArrays(GL_QUADS, p.first + t * 4, 4);
     }
+  } else
+    glDrawArrays(GL_QUADS, p.first, NZ * 4);
+}
+
+// do pass p, while recording the time step it goes into steps[] as well
+//
+void dopass(const pass &p) {
+  if (recording) {
+    if (nsteps < PMAX)
+      steps[nsteps++] = p;
+    else
+      stepdirect = true;
   }
 
+  glBindVertexArray(passvao);
+  drawpass(p);
+  glBindVertexArray(0);
   glUseProgram(0);
 }
 
-// copy a Fourier buffer to a real one
+// copy a real buffer to a Fourier buffer
 //
-void copybuffercr(int vo, int na) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, NX, 0, NY, -NZ, NZ);
-  glViewport(0, 0, NX, NY);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, fr[na]);
-  glUseProgram(shader_copybuffercr);
-
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(ttd, tb[vo]);
-  glUniform1i(glGetUniformLocation(shader_copybuffercr, "tex0"), 0);
-
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(ttd, tb[vo]);
-  glUniform1i(glGetUniformLocation(shader_copybuffercr, "tex1"), 1);
-
-  if (dims == 1) {
-    glFramebufferTexture1D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_1D,
-                           tr[na], 0);
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, 0.0 / (NX / 2 + 1));
-    glMultiTexCoord1d(GL_TEXTURE1, 0);
-    glVertex2d(0, 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, 1 - 1.0 / (NX / 2 + 1));
-    glMultiTexCoord1d(GL_TEXTURE1, NX);
-    glVertex2d(NX, 0.5);
-    glEnd();
-  } else if (dims == 2) {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           tr[na], 0);
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, 0.0 / (NX / 2 + 1), 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 0);
-    glVertex2i(0, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1 - 1.0 / (NX / 2 + 1), 0);
-    glMultiTexCoord2d(GL_TEXTURE1, NX, 0);
-    glVertex2i(NX, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1 - 1.0 / (NX / 2 + 1), 1);
-    glMultiTexCoord2d(GL_TEXTURE1, NX, 1);
-    glVertex2i(NX, NY);
-    glMultiTexCoord2d(GL_TEXTURE0, 0.0 / (NX / 2 + 1), 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 1);
-    glVertex2i(0, NY);
-    glEnd();
-  } else  // dims==3
-  {
-    for (int t = 0; t < NZ; t++) {
-      double l = (t + 0.5) / NZ;
-      glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                             GL_TEXTURE_3D, tr[na], 0, t);
-      glBegin(GL_QUADS);
-      glMultiTexCoord3d(GL_TEXTURE0, 0.0 / (NX / 2 + 1), 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 0, l);
-      glVertex3i(0, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1 - 1.0 / (NX / 2 + 1), 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, NX, 0, l);
-      glVertex3i(NX, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1 - 1.0 / (NX / 2 + 1), 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, NX, 1, l);
-      glVertex3i(NX, NY, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 0.0 / (NX / 2 + 1), 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 1, l);
-      glVertex3i(0, NY, t);
-      glEnd();
-    }
-  }
+void copybufferrc(int vo, int na) {
+  pass p;
+  passinit(p, shader_copybufferrc, fb[na], tb[na], NX / 2 + 1, quads_rc);
+  passcost(p, TCOPY, 2 * realbytes(vo), fourierbytes(na));
+  passtex(p, 0, ttd, tr[vo]);
+  passtex(p, 1, ttd, tr[vo]);
+  dopass(p);
+}
 
-  glUseProgram(0);
+// copy a Fourier buffer to a real one, ba=true copies the ba channels of an
+// RGBA Fourier buffer
+//
+void copybuffercr(int vo, int na, bool ba = false) {
+  pass p;
+  passinit(p, ba ? shader_copybuffercr4 : shader_copybuffercr, fr[na], tr[na],
+           NX, quads_cr);
+  passcost(p, TCOPY, fourierbytes(vo), realbytes(na));
+  passtex(p, 0, ttd, tb[vo]);
+  passtex(p, 1, ttd, tb[vo]);
+  dopass(p);
 }
 
 // do an FFT stage
 //
 void fft_stage(int dim, int eb, int si, int fftc, int ffto) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, NX / 2 + 1, 0, NY, -NZ, NZ);
-  glViewport(0, 0, NX / 2 + 1, NY);
+  bool four = ffto >= KF;  // RGBA buffers, two transforms at once
 
-  glBindFramebuffer(GL_FRAMEBUFFER, fb[ffto]);
-  glUseProgram(shader_fft);
-  glUniform1i(loc_dim, dim);
+  // x stages work on NX/2 points, but the real/complex one on NX/2+1
+  bool full = dim == 2 || dim == 3 || dim == 1 && si == -1 && eb == BX;
+
+  pass p;
+  passinit(p, four ? shader_fft4 : shader_fft, fb[ffto], tb[ffto], NX / 2 + 1,
+           full ? quads_f : quads_fx);
 
   int tang;
   double tangsc;
@@ -1781,91 +2691,147 @@ void fft_stage(int dim, int eb, int si, int fftc, int ffto) {
     tang = 0;
     tangsc = 0.0;
   }
-  glUniform1i(loc_tang, tang);
-  glUniform1f(loc_tangsc, (float)tangsc);
 
-  double gd;
-  int gi;
-  if (dim == 2 || dim == 3 || dim == 1 && si == -1 && eb == BX) {
-    gd = 1.0;
-    gi = NX / 2 + 1;
-  } else {
-    gd = 1.0 - 1.0 / (NX / 2 + 1);
-    gi = NX / 2;
-  }
+  int radix = 2;
+  if (dim == 1 && !tang) radix = RX[eb];
+  if (dim == 2) radix = RY[eb];
+  if (dim == 3) radix = RZ[eb];
+
+  p.iloc[0] = four ? loc_dim4 : loc_dim;
+  p.ival[0] = dim;
+  p.iloc[1] = four ? loc_tang4 : loc_tang;
+  p.ival[1] = tang;
+  p.iloc[2] = four ? loc_radix4 : loc_radix;
+  p.ival[2] = radix;
+  p.floc = four ? loc_tangsc4 : loc_tangsc;
+  p.fval = (float)tangsc;
+
+  passcost(p, TFFTX + dim - 1, radix * fourierbytes(fftc) + 16,
+           fourierbytes(ffto));  // + plan texel
+
+  passtex(p, 0, ttd, tb[fftc]);
+  if (dim == 1) passtex(p, 1, GL_TEXTURE_1D, planx[eb][(si + 1) / 2]);
+  if (dim == 2) passtex(p, 1, GL_TEXTURE_1D, plany[eb][(si + 1) / 2]);
+  if (dim == 3) passtex(p, 1, GL_TEXTURE_1D, planz[eb][(si + 1) / 2]);
+
+  dopass(p);
+}
+
+// one compute shader FFT dispatch along axis (1, 2, 3 for x, y, z), mode 0
+// complex from Fourier buffer cs to cd, 1 real buffer rb to Fourier buffer
+// cd, 2 Fourier buffer cs to real buffer rb (and rb2 for ba of RGBA buffers)
+//
+void fftc_axis(const fftcloc &l, int axis, int mode, int si, int cs, int cd,
+               int rb, int rb2) {
+  int n = axis == 1 ? NX / 2 : axis == 2 ? NY : NZ;
+  int radix[BMAX] = {0};
+  int nb = fft_radices(n, radix, FFTCRADIX);
+
+  GLboolean lay = dims == 3 ? GL_TRUE : GL_FALSE;
+  timerclass(TFFTX + axis - 1,
+             (long)(NX / 2 + 1) * NY * NZ * 2 * fourierbytes(cs));
+  glBindImageTexture(0, tb[cs], 0, lay, 0, GL_READ_WRITE, fourierfmt(cs));
+  glBindImageTexture(1, tb[cd], 0, lay, 0, GL_READ_WRITE, fourierfmt(cd));
+  glBindImageTexture(2, tr[rb], 0, lay, 0, GL_READ_WRITE, realfmt(rb));
+  glBindImageTexture(3, tr[rb2], 0, lay, 0, GL_READ_WRITE, realfmt(rb2));
 
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(ttd, tb[fftc]);
-  glUniform1i(glGetUniformLocation(shader_fft, "tex0"), 0);
+  glBindTexture(GL_TEXTURE_1D, twid[axis - 1]);
+
+  glUniform1i(l.axis, axis);
+  glUniform1i(l.mode, mode);
+  glUniform1i(l.n, n);
+  glUniform1i(l.nb, nb);
+  glUniform1iv(l.radix, BMAX, radix);
+  glUniform1i(l.twstep, axis == 1 ? 2 : 1);
+  glUniform1f(l.si, (float)si);
+
+  if (axis == 1) glDispatchCompute(NY, NZ, 1);
+  if (axis == 2) glDispatchCompute(NX / 2 + 1, NZ, 1);
+  if (axis == 3) glDispatchCompute(NX / 2 + 1, NY, 1);
+
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                  GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_FRAMEBUFFER_BARRIER_BIT);
+}
 
-  glActiveTexture(GL_TEXTURE1);
-  if (dim == 1) glBindTexture(GL_TEXTURE_1D, planx[eb][(si + 1) / 2]);
-  if (dim == 2) glBindTexture(GL_TEXTURE_1D, plany[eb][(si + 1) / 2]);
-  if (dim == 3) glBindTexture(GL_TEXTURE_1D, planz[eb][(si + 1) / 2]);
-  glUniform1i(glGetUniformLocation(shader_fft, "tex1"), 1);
+// do the FFT with the compute shaders, a whole row in one work group instead
+// of one pass per stage, false if that's not possible (no GL 4.3, rows longer
+// than FFTCMAX, a radix > 8, real to Fourier of an RGBA buffer, complex or
+// real buffers of different precision), fft does the fragment shader passes
+// then
+//
+bool fft_compute(int vo, int na, int si, int na2) {
+  bool four = vo >= KF;
+
+  // the image formats are fixed in the shader: all complex buffers must be
+  // half or all float, the same for the real ones
+  int c0 = si == -1 ? na : vo, c1 = si == -1 ? na : four ? FFT2 : FFT0;
+  int r0 = si == -1 ? vo : na, r1 = si == -1 || na2 < 0 ? r0 : na2;
+  bool ch = halffourier(c0), rh = halfreal(r0);
+  if (halffourier(c1) != ch || halfreal(r1) != rh || (rh && !ch))
+    return false;
+  int v = !ch ? 0 : rh ? 2 : 1;
+  GLuint prog = four ? shader_fftc4[v] : shader_fftc[v];
+  const fftcloc &l = four ? loc_fftc4[v] : loc_fftc[v];
+
+  if (!fftcompute || !prog) return false;
+  if (si == -1 && four) return false;
+
+  int n[3] = {NX / 2, NY, NZ};
+  for (int a = 0; a < dims; a++) {
+    int radix[BMAX];
+    if (n[a] > FFTCMAX) return false;
+    int nb = fft_radices(n[a], radix, FFTCRADIX);
+    for (int k = 1; k <= nb; k++)
+      if (radix[k] > 8) return false;
+  }
 
-  if (dims == 1) {
-    glFramebufferTexture1D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_1D,
-                           tb[ffto], 0);
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, 0);
-    glMultiTexCoord1d(GL_TEXTURE1, 0);
-    glVertex2d(0, 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, gd);
-    glMultiTexCoord1d(GL_TEXTURE1, gd);
-    glVertex2d(gi, 0.5);
-    glEnd();
-  } else if (dims == 2) {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           tb[ffto], 0);
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 0);
-    glVertex2i(0, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, gd, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, gd, 0);
-    glVertex2i(gi, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, gd, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, gd, 1);
-    glVertex2i(gi, NY);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 1);
-    glVertex2i(0, NY);
-    glEnd();
-  } else  // dims==3
+  glUseProgram(prog);
+
+  if (si == -1)  // real to Fourier, the y and z rows in place
   {
-    for (int t = 0; t < NZ; t++) {
-      double l = (t + 0.5) / NZ;
-      glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                             GL_TEXTURE_3D, tb[ffto], 0, t);
-      glBegin(GL_QUADS);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 0, l);
-      glVertex3i(0, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, gd, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, gd, 0, l);
-      glVertex3i(gi, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, gd, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, gd, 1, l);
-      glVertex3i(gi, NY, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 1, l);
-      glVertex3i(0, NY, t);
-      glEnd();
+    fftc_axis(l, 1, 1, si, na, na, vo, vo);
+    if (dims > 1) fftc_axis(l, 2, 0, si, na, na, vo, vo);
+    if (dims > 2) fftc_axis(l, 3, 0, si, na, na, vo, vo);
+  } else  // si==1, Fourier to real, vo stays as it is
+  {
+    int cur = four ? FFT2 : FFT0;
+    int src = vo;
+    if (dims > 2) {
+      fftc_axis(l, 3, 0, si, src, cur, na, na);
+      src = cur;
     }
+    if (dims > 1) {
+      fftc_axis(l, 2, 0, si, src, cur, na, na);
+      src = cur;
+    }
+    fftc_axis(l, 1, 2, si, src, src, na, na2 >= 0 ? na2 : na);
   }
 
   glUseProgram(0);
+  return true;
 }
 
-// do the FFT on a buffer
+// do the FFT on a buffer, an RGBA Fourier buffer vo (si==1 only) does two
+// transforms at once, rg goes to na and ba to na2
 //
-void fft(int vo, int na, int si) {
+void fft(int vo, int na, int si, int na2 = -1) {
   int t, s;
   int fftcur, fftoth;
 
-  fftcur = FFT0;
-  fftoth = FFT1;
+  if (fft_compute(vo, na, si, na2)) {
+    if (recording) stepdirect = true;  // dispatches aren't recorded
+    return;
+  }
+
+  if (si == 1 && vo >= KF) {
+    fftcur = FFT2;
+    fftoth = FFT3;
+  } else {
+    fftcur = FFT0;
+    fftoth = FFT1;
+  }
 
   if (si == -1)  // real to Fourier
   {
@@ -1912,242 +2878,1474 @@ void fft(int vo, int na, int si) {
       fftoth = s;
     }
 
-    for (t = 1; t <= BY; t++) {
-      if (dims == 2 && t == 1)
-        fft_stage(2, t, si, vo, fftoth);
-      else
-        fft_stage(2, t, si, fftcur, fftoth);
-      s = fftcur;
-      fftcur = fftoth;
-      fftoth = s;
-    }
+    for (t = 1; t <= BY; t++) {
+      if (dims == 2 && t == 1)
+        fft_stage(2, t, si, vo, fftoth);
+      else
+        fft_stage(2, t, si, fftcur, fftoth);
+      s = fftcur;
+      fftcur = fftoth;
+      fftoth = s;
+    }
+
+    for (t = 0; t <= BX - 1; t++) {
+      if (dims == 1 && t == 0)
+        fft_stage(1, t, si, vo, fftoth);
+      else
+        fft_stage(1, t, si, fftcur, fftoth);
+      s = fftcur;
+      fftcur = fftoth;
+      fftoth = s;
+    }
+
+    copybuffercr(fftcur, na);
+    if (na2 >= 0) copybuffercr(fftcur, na2, true);
+  }
+}
+
+// multiply with kernel (Fourier buffers), scale
+//
+void kernelmul(int vo, int ke, int na, double sc) {
+  bool four = na >= KF;  // RGBA kernel and result, two products at once
+
+  pass p;
+  passinit(p, four ? shader_kernelmul4 : shader_kernelmul, fb[na], tb[na],
+           NX / 2 + 1, quads_f);
+  p.floc = four ? loc_sc4 : loc_sc;
+  p.fval = (float)sc;
+  passcost(p, TMUL, fourierbytes(vo) + fourierbytes(ke), fourierbytes(na));
+  passtex(p, 0, ttd, tb[vo]);
+  passtex(p, 1, ttd, tb[ke]);
+  dopass(p);
+}
+
+// put the real parts of the ring and disk kernel spectra kr and kd (as
+// kspecget gives them) together into KF, scaled for the packed time step
+// (ring in r, disk in g), nothing for the unpacked one
+//
+void packspectra(const float *kr, const float *kd) {
+  int n = (NX / 2 + 1) * NY * NZ;
+  float *kf;
+  int t;
+
+  if (!packed) return;
+
+  kf = (float *)calloc(n * 2, sizeof(float));
+  if (kf == 0) {
+    fprintf(logfile, "packspectra failed\n");
+    fflush(logfile);
+    return;
+  }
+
+  double scr = sqrt(NX * NY * NZ) / kflr;
+  double scd = sqrt(NX * NY * NZ) / kfld;
+  for (t = 0; t < n; t++) {
+    kf[t * 2 + 0] = (float)(kr[t * 2] * scr);
+    kf[t * 2 + 1] = (float)(kd[t * 2] * scd);
+  }
+
+  glBindTexture(ttd, tb[KF]);
+  if (dims == 1)
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX / 2 + 1, GL_RG, GL_FLOAT, kf);
+  if (dims == 2)
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX / 2 + 1, NY, GL_RG, GL_FLOAT,
+                    kf);
+  if (dims == 3)
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, NX / 2 + 1, NY, NZ, GL_RG,
+                    GL_FLOAT, kf);
+
+  free(kf);
+}
+
+// sin(x)/x
+//
+double sinc(double x) { return fabs(x) < 1e-8 ? 1.0 : sin(x) / x; }
+
+// Fourier transform at angular frequency k (grid spacing 1) of the radial
+// profile 1 - func_linear(r, a, e) in dims dimensions, it is the mean of the
+// transforms of hard balls with radii from a-e/2 to a+e/2: closed form in 1D,
+// Gauss-Legendre over the radius in 2D (J1) and 3D (PI is 2 pi here)
+//
+double rampft(double k, double a, double e, int dims) {
+  static const double gx[4] = {0.1834346424956498, 0.5255324099163290,
+                               0.7966664774136267, 0.9602898564975363};
+  static const double gw[4] = {0.3626837833783620, 0.3137066458778873,
+                               0.2223810344533745, 0.1012285362903763};
+  double sum = 0.0;
+  int g, h;
+
+  if (dims == 1) return 2.0 * a * sinc(k * a) * sinc(k * e / 2.0);
+
+  for (g = 0; g < 4; g++)
+    for (h = -1; h <= 1; h += 2) {
+      double r = a + h * gx[g] * e / 2.0;
+      double x = k * r;
+      double b;
+      if (dims == 2)  // 2 pi r J1(kr) / k
+        b = PI * r * r * (x < 1e-8 ? 0.5 : j1(x) / x);
+      else  // 4 pi (sin(kr) - kr cos(kr)) / k^3
+        b = 2.0 * PI * r * r * r *
+            (x < 1e-2 ? 1.0 / 3.0 - x * x / 30.0
+                      : (sin(x) - x * cos(x)) / (x * x * x));
+      sum += gw[g] * b;
+    }
+
+  return sum / 2.0;
+}
+
+// spectra of the ring and disk kernel of key k with radii ra, rr, rb made
+// analytically, KRF then KDF as kspecput takes them (calloced), their areas
+// go to kr and kd, 0 if the ring and disk edges overlap (the ring isn't the
+// difference of two disks then), if the kernel doesn't fit into half the
+// buffer (it would wrap around differently) or out of memory (no globals, the
+// prefetch thread uses it), it's the transform of the continuous kernel, the
+// rasterized one of makekernel differs by aliasing (1-3% of the maximum in
+// 2D and 3D, 4-6% in 1D)
+//
+float *kspecanalytic(const kernelkey &k, double ra, double rr, double rb,
+                     double &kr, double &kd) {
+  int fx = k.nx / 2 + 1;
+  long n = (long)fx * k.ny * k.nz;
+  double ri = ra / rr;
+  double bb = ra / rb;
+  double sc = 1.0 / sqrt((double)k.nx * k.ny * k.nz);  // unitary FFT
+  int ix, iy, iz, y, z, t;
+
+  if (ri + bb / 2.0 > ra - bb / 2.0) return 0;
+  if (ra + bb / 2.0 >= k.nx / 2 || (k.dims > 1 && ra + bb / 2.0 >= k.ny / 2) ||
+      (k.dims > 2 && ra + bb / 2.0 >= k.nz / 2))
+    return 0;
+
+  float *spec = (float *)calloc(n * 4, sizeof(float));
+  if (spec == 0) return 0;
+
+  // rampft is smooth in |k| (up to pi sqrt(dims)), tabulate it for the disk
+  // and the ring with steps of 1/128 radian at the outer edge and interpolate
+  double h = 1.0 / (128.0 * (ra + bb));
+  int nt = (int)(PI / 2.0 * sqrt((double)k.dims) / h) + 2;
+  double *td = (double *)calloc(nt * 2, sizeof(double));
+  if (td == 0) {
+    free(spec);
+    return 0;
+  }
+  for (t = 0; t < nt; t++) {
+    td[t * 2] = rampft(t * h, ri, bb, k.dims);
+    td[t * 2 + 1] = rampft(t * h, ra, bb, k.dims) - td[t * 2];
+  }
+
+  for (iz = 0; iz < k.nz; iz++) {
+    z = k.dims > 2 && iz > k.nz / 2 ? iz - k.nz : iz;
+    for (iy = 0; iy < k.ny; iy++) {
+      y = k.dims > 1 && iy > k.ny / 2 ? iy - k.ny : iy;
+      for (ix = 0; ix < fx; ix++) {
+        double kx = (double)ix / k.nx;
+        double ky = (double)y / k.ny;
+        double kz = (double)z / k.nz;
+        double u = PI * sqrt(kx * kx + ky * ky + kz * kz) / h;
+        t = (int)u;
+        u -= t;
+        long o = ((long)iz * k.ny + iy) * fx + ix;
+        double *p = td + t * 2;
+        spec[o * 2] = (float)((p[1] * (1 - u) + p[3] * u) * sc);
+        spec[(n + o) * 2] = (float)((p[0] * (1 - u) + p[2] * u) * sc);
+      }
+    }
+  }
+  free(td);
+
+  kd = rampft(0.0, ri, bb, k.dims);
+  kr = rampft(0.0, ra, bb, k.dims) - kd;
+  return spec;
+}
+
+// key of the current kernel with radius r
+//
+kernelkey kkey(double r) {
+  kernelkey k;
+  memset(&k, 0, sizeof(kernelkey));
+  k.dims = dims;
+  k.nx = NX;
+  k.ny = NY;
+  k.nz = NZ;
+  k.ra = (int)floor(r * 1000 + 0.5);
+  k.rr = (int)floor(rr * 1000 + 0.5);
+  k.rb = (int)floor(rb * 1000 + 0.5);
+  k.analytic = kernelfourier;
+  k.half = halfbufs;
+  return k;
+}
+
+// bytes of the KRF and KDF spectra of kernel k
+//
+long kspecbytes(const kernelkey &k) {
+  return (long)(k.nx / 2 + 1) * k.ny * k.nz * 2 * 2 * sizeof(float);
+}
+
+// spectra of the current size are cached (and prefetched) only if at least
+// 4 of them fit into the cache
+//
+bool kspecfits(void) { return kspecbytes(kkey(ra)) <= KCACHEMEM / 4; }
+
+// name of the kernelcache/ file of kernel k
+//
+void kfilename(char *fname, const kernelkey &k) {
+  sprintf(fname, "kernelcache/%dD_%dx%dx%d_%d_%d_%d%s%s.ksp", k.dims, k.nx,
+          k.ny, k.nz, k.ra, k.rr, k.rb, k.analytic ? "_a" : "",
+          k.half == 2 ? "_h2" : k.half ? "_h1" : "");
+}
+
+// the spectra are also kept on disk if the directory kernelcache/ exists
+//
+bool kcachedir(void) {
+  struct stat st;
+  return stat("kernelcache", &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// drop cache entry t
+//
+void kcache_drop(int t) {
+  if (kcache[t].map)
+    munmap(kcache[t].map, kcache[t].bytes);
+  else
+    free(kcache[t].spec);
+  kcache[t] = kcache[--nkcache];
+}
+
+// drop the least recently used entries until bytes more fit into the cache
+//
+void kcache_room(long bytes) {
+  int t, lru;
+  long sum;
+
+  for (;;) {
+    sum = bytes;
+    lru = -1;
+    for (t = 0; t < nkcache; t++) {
+      sum += kcache[t].bytes;
+      if (lru < 0 || kcache[t].used < kcache[lru].used) lru = t;
+    }
+    if (lru < 0 || (nkcache < KCACHEN && sum <= KCACHEMEM)) return;
+    kcache_drop(lru);
+  }
+}
+
+// find kernel k in the cache, else map its kernelcache/ file into it, 0 if
+// it's in neither
+//
+kernelspec *kcache_find(const kernelkey &k) {
+  int t;
+
+  for (t = 0; t < nkcache; t++)
+    if (memcmp(&kcache[t].key, &k, sizeof(kernelkey)) == 0) {
+      kcache[t].used = ++kcacheuse;
+      return &kcache[t];
+    }
+
+  if (!kcachedir()) return 0;
+
+  char fname[256];
+  kfilename(fname, k);
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return 0;
+
+  long bytes = sizeof(kernelfilehead) + kspecbytes(k);
+  struct stat st;
+  char *map = (char *)MAP_FAILED;
+  if (fstat(fileno(fp), &st) == 0 && st.st_size == bytes)
+    map = (char *)mmap(0, bytes, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  fclose(fp);
+  if (map == (char *)MAP_FAILED) {
+    fprintf(logfile, "can't map %s\n", fname);
+    fflush(logfile);
+    return 0;
+  }
+
+  kernelfilehead *h = (kernelfilehead *)map;
+  if (memcmp(h->magic, "SLKSPEC", 8) ||
+      memcmp(&h->key, &k, sizeof(kernelkey))) {
+    fprintf(logfile, "%s is no kernel spectra file for its name\n", fname);
+    fflush(logfile);
+    munmap(map, bytes);
+    return 0;
+  }
+
+  kcache_room(bytes);
+  kernelspec &e = kcache[nkcache++];
+  e.key = k;
+  e.kflr = h->kflr;
+  e.kfld = h->kfld;
+  e.spec = (float *)(map + sizeof(kernelfilehead));
+  e.map = map;
+  e.bytes = bytes;
+  e.used = ++kcacheuse;
+  return &e;
+}
+
+// put the spectra spec (calloced, the cache frees it) of kernel k with areas
+// kr, kd into the cache and into kernelcache/
+//
+void kcache_store(const kernelkey &k, double kr, double kd, float *spec) {
+  int t;
+
+  for (t = 0; t < nkcache; t++)
+    if (memcmp(&kcache[t].key, &k, sizeof(kernelkey)) == 0) {
+      free(spec);
+      return;
+    }
+
+  long bytes = kspecbytes(k);
+  kcache_room(bytes);
+  kernelspec &e = kcache[nkcache++];
+  e.key = k;
+  e.kflr = kr;
+  e.kfld = kd;
+  e.spec = spec;
+  e.map = 0;
+  e.bytes = bytes;
+  e.used = ++kcacheuse;
+
+  if (!kcachedir()) return;
+
+  // written to fname.tmp and renamed, another process may have the old file
+  // mapped (kcache_find) and a crash must not leave a partial one
+  char fname[256], tmp[272];
+  kernelfilehead h;
+  memset(&h, 0, sizeof(kernelfilehead));
+  strcpy(h.magic, "SLKSPEC");
+  h.key = k;
+  h.kflr = kr;
+  h.kfld = kd;
+  kfilename(fname, k);
+  sprintf(tmp, "%s.tmp", fname);
+  bool ok = false;
+  FILE *fp = fopen(tmp, "wb");
+  if (fp) {
+    ok = fwrite(&h, sizeof(kernelfilehead), 1, fp) == 1 &&
+         fwrite(spec, bytes, 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    if (ok) ok = rename(tmp, fname) == 0;
+    if (!ok) remove(tmp);
+  }
+  if (!ok) {
+    fprintf(logfile, "can't write %s\n", fname);
+    fflush(logfile);
+  }
+}
+
+// put the real part of spectrum spec (as kspecget gives it) into kernel
+// spectrum buffer b (R)
+//
+void kspecput(int b, const float *spec) {
+  long n = (long)(NX / 2 + 1) * NY * NZ;
+  float *re = (float *)calloc(n, sizeof(float));
+
+  if (re == 0) {
+    fprintf(logfile, "kspecput failed\n");
+    fflush(logfile);
+    return;
+  }
+  for (long t = 0; t < n; t++) re[t] = spec[t * 2];
+
+  glBindTexture(ttd, tb[b]);
+  if (dims == 1)
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX / 2 + 1, GL_RED, GL_FLOAT, re);
+  if (dims == 2)
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX / 2 + 1, NY, GL_RED, GL_FLOAT,
+                    re);
+  if (dims == 3)
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, NX / 2 + 1, NY, NZ, GL_RED,
+                    GL_FLOAT, re);
+  free(re);
+}
+
+// copy the spectrum of Fourier buffer b (RG) to spec
+//
+void kspecget(int b, float *spec) {
+  glBindTexture(ttd, tb[b]);
+  glGetTexImage(ttd, 0, GL_RG, GL_FLOAT, spec);
+}
+
+// largest imaginary part of the n complex values of spec relative to the
+// largest real part, the kernels are real and point symmetric (the same at
+// x and -x, periodic), so their spectra are real up to rounding, and only
+// the real parts are kept in KRF, KDF, KF
+//
+double kspecimag(const float *spec, long n) {
+  double re = 0.0, im = 0.0;
+
+  for (long t = 0; t < n; t++) {
+    if (fabs(spec[t * 2]) > re) re = fabs(spec[t * 2]);
+    if (fabs(spec[t * 2 + 1]) > im) im = fabs(spec[t * 2 + 1]);
+  }
+  return re > 0.0 ? im / re : 0.0;
+}
+
+// transform the ring and disk kernels in real buffers kr, kd in AF (a time
+// step overwrites it anyway) and return the spectra, ring then disk as
+// kspecget gives them (calloced), 0 if out of memory
+//
+float *kspecmake(int kr, int kd) {
+  long n = (long)(NX / 2 + 1) * NY * NZ;
+  float *spec = (float *)calloc(n * 4, sizeof(float));
+
+  if (spec == 0) {
+    fprintf(logfile, "kspecmake failed\n");
+    fflush(logfile);
+    return 0;
+  }
+  fft(kr, AF, -1);
+  kspecget(AF, spec);
+  fft(kd, AF, -1);
+  kspecget(AF, spec + n * 2);
+  return spec;
+}
+
+// put the spectra spec (as kspecmake returns them) into KRF, KDF or KF for
+// the time step, their imaginary parts are dropped, so check that they're
+// negligible
+//
+void kspecuse(const float *spec) {
+  long n = (long)(NX / 2 + 1) * NY * NZ;
+  double im = kspecimag(spec, n * 2);
+
+  fprintf(logfile, "kernel spectra imag/real %g\n", im);
+  fflush(logfile);
+  if (im > KIMAGTOL) {
+    fprintf(logfile, "kernel spectra aren't real, imag/real %g > %g\n", im,
+            KIMAGTOL);
+    fflush(logfile);
+    savedispcnt = 5.0;
+    sprintf(dispmessage, " kernel spectra not real (%.1e) ", im);
+  }
+
+  if (!packed) {
+    kspecput(KRF, spec);
+    kspecput(KDF, spec + n * 2);
+  }
+  packspectra(spec, spec + n * 2);
+}
+
+// kernel prefetch thread, builds the real kernels of kpjob[] one after the
+// other, kernelpoll takes each one before the next is done
+//
+void *kernelthread(void *arg) {
+  pthread_mutex_lock(&kpmutex);
+  for (;;) {
+    while (nkpjob == 0 || kpdone) pthread_cond_wait(&kpcond, &kpmutex);
+    kerneljob j = kpjob[0];
+    nkpjob--;
+    memmove(kpjob, kpjob + 1, nkpjob * sizeof(kerneljob));
+    pthread_mutex_unlock(&kpmutex);
+
+    kernelbox b;
+    double kr = 0.0, kd = 0.0;
+    float *spec = 0;
+    bool ok;
+    memset(&b, 0, sizeof(b));
+    if (j.key.analytic) spec = kspecanalytic(j.key, j.ra, j.rr, j.rb, kr, kd);
+    if (spec)
+      ok = true;
+    else {
+      // not parallel_for, the main thread may be in it
+      ok = kernelboxmake(b, j.key.dims, j.key.nx, j.key.ny, j.key.nz, j.ra,
+                         j.rr, j.rb, false);
+      kr = b.kr;
+      kd = b.kd;
+    }
+
+    pthread_mutex_lock(&kpmutex);
+    if (ok) {
+      kpkey = j.key;
+      kpbox = b;
+      kpspec = spec;
+      kpkflr = kr;
+      kpkfld = kd;
+      kpdone = true;
+    }
+  }
+  return 0;
+}
+
+// let the prefetch thread build the kernels for the radii of the keys T/G
+// (ra +-0.1) and ra +-1.0, unless they are cached already
+//
+void kernelprefetch(void) {
+  static const double dr[4] = {0.1, -0.1, 1.0, -1.0};
+
+  if (!kspecfits()) return;
+
+  pthread_mutex_lock(&kpmutex);
+  nkpjob = 0;
+  for (int t = 0; t < 4; t++) {
+    double r = ra + dr[t];
+    if (r < 1.0) continue;
+    kernelkey k = kkey(r);
+    if (kcache_find(k)) continue;
+    kpjob[nkpjob].key = k;
+    kpjob[nkpjob].ra = r;
+    kpjob[nkpjob].rr = rr;
+    kpjob[nkpjob].rb = rb;
+    nkpjob++;
+  }
+  if (nkpjob > 0 && !kprunning)
+    kprunning = pthread_create(&kpthread, NULL, kernelthread, NULL) == 0;
+  pthread_cond_signal(&kpcond);
+  pthread_mutex_unlock(&kpmutex);
+}
+
+// transform a kernel the prefetch thread has built and cache it, KR, KD and
+// AF are used for it (KR, KD stay float in half mode, kernelreals makes the
+// current kernel again for the views)
+//
+void kernelpoll(void) {
+  pthread_mutex_lock(&kpmutex);
+  if (!kpdone) {
+    pthread_mutex_unlock(&kpmutex);
+    return;
+  }
+  kernelkey k = kpkey;
+  kernelbox b = kpbox;
+  double kr = kpkflr, kd = kpkfld;
+  float *spec = kpspec;
+  kpdone = false;
+  pthread_cond_signal(&kpcond);
+  pthread_mutex_unlock(&kpmutex);
+
+  if (spec) {  // analytic spectra, nothing to transform
+    kcache_store(k, kr, kd, spec);
+    return;
+  }
+
+  // the size may have changed since
+  if (k.dims == dims && k.nx == NX && k.ny == NY && k.nz == NZ) {
+    kernelupload(b, b.ar, KR);
+    kernelupload(b, b.ad, KD);
+    kernelreal = false;
+
+    spec = kspecmake(KR, KD);
+    if (spec) kcache_store(k, kr, kd, spec);
+
+    fprintf(logfile, "prefetched kernel ra=%.3f\n", k.ra / 1000.0);
+    fflush(logfile);
+  }
+
+  kernelboxfree(b);
+}
+
+// make the kernel spectra KRF, KDF (unpacked step) or KF (packed step) for
+// the current paras, from the cache if they are in it, then prefetch the
+// neighbouring radii
+//
+void kernelspectra(void) {
+  kernelkey k = kkey(ra);
+  kernelspec *e = kspecfits() ? kcache_find(k) : 0;
+  float *spec = 0;
+
+  if (e == 0 && kernelfourier)
+    spec = kspecanalytic(k, ra, rr, rb, kflr, kfld);
+
+  if (spec) {
+    kspecuse(spec);
+    kernelreal = false;
+    newsteps();
+    if (kspecfits())
+      kcache_store(k, kflr, kfld, spec);
+    else
+      free(spec);
+    fprintf(logfile, "kernel ra=%lf rr=%lf rb=%lf kflr=%lf kfld=%lf analytic\n",
+            ra, rr, rb, kflr, kfld);
+    fflush(logfile);
+  } else if (e) {
+    kflr = e->kflr;
+    kfld = e->kfld;
+    kspecuse(e->spec);
+    kernelreal = false;
+    newsteps();
+    fprintf(logfile, "kernel ra=%lf rr=%lf rb=%lf from cache\n", ra, rr, rb);
+    fflush(logfile);
+  } else {
+    makekernel(KR, KD);
+    spec = kspecmake(KR, KD);
+    if (spec) {
+      kspecuse(spec);
+      if (kspecfits())
+        kcache_store(k, kflr, kfld, spec);
+      else
+        free(spec);
+    }
+  }
+
+  kernelprefetch();
+}
+
+// KR and KD for the kernel views, made anew if something used their storage
+// (their spectra may be gone too), the areas of the kernel in use stay
+//
+void kernelreals(void) {
+  if (kernelreal) return;
+  double kr = kflr, kd = kfld;
+  makekernel(KR, KD);
+  kflr = kr;
+  kfld = kd;
+}
+
+// apply the snm function (real buffers)
+//
+void snm(int an, int am, int na) {
+  pass p;
+  passinit(p, shader_snm, fr[na], tr[na], NX, quads_f);
+  passcost(p, TSNM, realbytes(an) + realbytes(am) + realbytes(na),
+           realbytes(na));
+  p.snmparas = true;
+  passtex(p, 0, ttd, tr[an]);
+  passtex(p, 1, ttd, tr[am]);
+  passtex(p, 2, ttd, tr[na]);
+  dopass(p);
+}
+
+// one time step of AA, the first one after newsteps records its passes, the
+// next ones just replay them
+//
+void timestep(void) {
+  kernelreal = false;  // AN, AM get overwritten
+  if (nsteps > 0) {
+    glBindVertexArray(passvao);
+    for (int t = 0; t < nsteps; t++) drawpass(steps[t]);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    return;
+  }
+
+  recording = !stepdirect;
+  fft(AA, AF, -1);
+  if (packed) {
+    kernelmul(AF, KF, ANMF, 1.0);
+    fft(ANMF, AN, 1, AM);
+  } else {  // ANF and AMF share FFT0, see planbuffers
+    kernelmul(AF, KRF, ANF, sqrt(NX * NY * NZ) / kflr);
+    fft(ANF, AN, 1);
+    kernelmul(AF, KDF, AMF, sqrt(NX * NY * NZ) / kfld);
+    fft(AMF, AM, 1);
+  }
+  snm(AN, AM, AA);
+  recording = false;
+  if (stepdirect) nsteps = 0;
+}
+
+// initialize an and am with 0 to 1 gradient for drawing of snm (2D only)
+//
+void initan(int a) {
+  float *buf = (float *)calloc(NX * NY, sizeof(float));
+
+  int x, y;
+
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      buf[y * NX + x] = (float)x / NX;
+    }
+
+  glBindTexture(GL_TEXTURE_2D, tr[a]);
+  glTexImage2D(GL_TEXTURE_2D, 0, realfmt(a), NX, NY, 0, GL_RED, GL_FLOAT,
+               buf);
+
+  free(buf);
+}
+
+void initam(int a) {
+  float *buf = (float *)calloc(NX * NY, sizeof(float));
+
+  int x, y;
+
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      buf[y * NX + x] = (float)y / NY;
+    }
+
+  glBindTexture(GL_TEXTURE_2D, tr[a]);
+  glTexImage2D(GL_TEXTURE_2D, 0, realfmt(a), NX, NY, 0, GL_RED, GL_FLOAT,
+               buf);
+
+  free(buf);
+}
+
+// draw snm function into buffer (2D only)
+//
+void makesnm(int an, int am, int asnm) {
+  initan(an);
+  initam(am);
+  snm(an, am, asnm);
+  kernelreal = false;
+}
+
+// checkpoint writer thread, writes ckhead and the mapped AA to ckname.tmp
+// and renames it, so an old checkpoint stays intact until the new one is
+//
+void *checkpointthread(void *arg) {
+  long n = (long)ckhead.nx * ckhead.ny * ckhead.nz;
+  char tmp[272];
+  bool ok = false;
+
+  sprintf(tmp, "%s.tmp", ckname);
+  FILE *file = fopen(tmp, "wb");
+  if (file) {
+    char pad[CHECKDATA - sizeof(checkhead)];
+    memset(pad, 0, sizeof(pad));
+    ok = fwrite(&ckhead, sizeof(checkhead), 1, file) == 1 &&
+         fwrite(pad, sizeof(pad), 1, file) == 1 &&
+         fwrite(ckdata, sizeof(float), n, file) == (size_t)n;
+    ok = fclose(file) == 0 && ok;
+    if (ok) ok = rename(tmp, ckname) == 0;
+  }
+
+  pthread_mutex_lock(&ckmutex);
+  ckok = ok;
+  ckdone = true;
+  pthread_mutex_unlock(&ckmutex);
+  return 0;
+}
+
+// save AA and the paras to checkpoint file name, without waiting: AA is read
+// back into a pixel pack buffer, checkpointpoll hands it to the writer thread
+// when the GPU is done
+//
+void checkpointsave(const char *name) {
+  long n = (long)NX * NY * NZ;
+
+  if (ckfence || ckwriting) {
+    fprintf(logfile, "checkpoint %s skipped, still saving\n", name);
+    fflush(logfile);
+    return;
+  }
+
+  memset(&ckhead, 0, sizeof(ckhead));
+  memcpy(ckhead.magic, "SLCHECK", 8);
+  ckhead.version = CHECKVERSION;
+  ckhead.nx = NX;
+  ckhead.ny = NY;
+  ckhead.nz = NZ;
+  ckhead.data = CHECKDATA;
+  ckhead.stepnr = stepnr;
+  ckhead.seed = seed;
+  ckhead.curparas = curparas;
+  getparas(ckhead.p);
+  if (curparas >= 0 && curparas < nparas)
+    strcpy(ckhead.p.desc, paralist[curparas].desc);
+  snprintf(ckname, sizeof(ckname), "%s", name);
+
+  if (ckpbo == 0) glGenBuffers(1, &ckpbo);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, ckpbo);
+  glBufferData(GL_PIXEL_PACK_BUFFER, n * sizeof(float), 0, GL_STREAM_READ);
+  glBindTexture(ttd, tr[AA]);
+  glGetTexImage(ttd, 0, GL_RED, GL_FLOAT, 0);
+  glBindTexture(ttd, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  ckfence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// once per frame: start the writer thread when the readback is done, unmap
+// the buffer when it's written, autosave every AUTOSAVE ms
+//
+void checkpointpoll(void) {
+  if (ckfence) {
+    GLenum r = glClientWaitSync(ckfence, 0, 0);
+    if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED) {
+      glDeleteSync(ckfence);
+      ckfence = 0;
+      long n = (long)ckhead.nx * ckhead.ny * ckhead.nz;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ckpbo);
+      ckdata = (float *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                         n * sizeof(float), GL_MAP_READ_BIT);
+      ckdone = false;
+      ckwriting = ckdata != 0 &&
+                  pthread_create(&ckthread, NULL, checkpointthread, NULL) == 0;
+      if (!ckwriting) {
+        if (ckdata) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        fprintf(logfile, "checkpoint %s failed\n", ckname);
+        fflush(logfile);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    } else if (r == GL_WAIT_FAILED) {
+      glDeleteSync(ckfence);
+      ckfence = 0;
+    }
+  }
+
+  if (ckwriting) {
+    pthread_mutex_lock(&ckmutex);
+    bool done = ckdone;
+    pthread_mutex_unlock(&ckmutex);
+    if (done) {
+      pthread_join(ckthread, 0);
+      ckwriting = false;
+      ckdata = 0;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ckpbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      fprintf(logfile, "checkpoint %s step %ld %s\n", ckname, ckhead.stepnr,
+              ckok ? "saved" : "failed");
+      fflush(logfile);
+    }
+  }
+
+  if (AUTOSAVE && !pause && SDL_GetTicks() - cklast > AUTOSAVE) {
+    cklast = SDL_GetTicks();
+    checkpointsave(AUTOFILE);
+  }
+}
+
+// wait for a checkpoint still being saved (program end)
+//
+void checkpointwait(void) {
+  while (ckfence || ckwriting) checkpointpoll();
+  if (ckpbo) glDeleteBuffers(1, &ckpbo);
+  ckpbo = 0;
+}
+
+// map checkpoint file name and take its paras, the buffers have to be made
+// anew (neuedim), checkpointrestore then puts the saved AA into them, false
+// if it's no checkpoint of this version
+//
+bool checkpointload(const char *name) {
+  struct stat st;
+  FILE *file = fopen(name, "rb");
+
+  if (file == 0) return false;
+  if (fstat(fileno(file), &st) != 0 || st.st_size < (long)sizeof(checkhead)) {
+    fclose(file);
+    return false;
+  }
+  char *map = (char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE,
+                           fileno(file), 0);
+  fclose(file);
+  if (map == MAP_FAILED) return false;
+
+  checkhead h;
+  memcpy(&h, map, sizeof(h));
+  long n = (long)h.nx * h.ny * h.nz;
+  if (memcmp(h.magic, "SLCHECK", 8) != 0 || h.version != CHECKVERSION ||
+      h.p.dims < 1 || h.p.dims > 3 || h.nx < 2 || h.nx % 2 || h.ny < 1 ||
+      h.nz < 1 || (h.p.dims < 2 && h.ny > 1) || (h.p.dims < 3 && h.nz > 1) ||
+      h.data < (long)sizeof(checkhead) || h.data % sizeof(float) ||
+      h.data + n * (long)sizeof(float) > st.st_size) {
+    munmap(map, st.st_size);
+    fprintf(logfile, "%s is no checkpoint of version %d\n", name,
+            CHECKVERSION);
+    fflush(logfile);
+    return false;
+  }
 
-    for (t = 0; t <= BX - 1; t++) {
-      if (dims == 1 && t == 0)
-        fft_stage(1, t, si, vo, fftoth);
-      else
-        fft_stage(1, t, si, fftcur, fftoth);
-      s = fftcur;
-      fftcur = fftoth;
-      fftoth = s;
+  if (rsmap) munmap(rsmap, rsbytes);
+  rsmap = map;
+  rsbytes = st.st_size;
+  rshead = h;
+
+  putparas(h.p);
+  if (h.curparas >= 0 && h.curparas < nparas) curparas = h.curparas;
+  return true;
+}
+
+// put the buffer of the loaded checkpoint into AA (after create_buffers)
+//
+void checkpointrestore(void) {
+  const float *a = (const float *)(rsmap + rshead.data);
+
+  glBindTexture(ttd, tr[AA]);
+  if (dims == 1)
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, NX, GL_RED, GL_FLOAT, a);
+  if (dims == 2)
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, GL_RED, GL_FLOAT, a);
+  if (dims == 3)
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, NX, NY, NZ, GL_RED, GL_FLOAT,
+                    a);
+  glBindTexture(ttd, 0);
+  stepnr = rshead.stepnr;
+  seed = rshead.seed;
+
+  munmap(rsmap, rsbytes);
+  rsmap = 0;
+
+  fprintf(logfile, "checkpoint restored, step %ld\n", stepnr);
+  fflush(logfile);
+}
+
+// write one captured frame (writer thread), converted to Y'CbCr 4:4:4 with
+// the BT.601 studio range for y4m, rows top first
+//
+bool capturewrite(const unsigned char *rgb, unsigned char *yuv) {
+  long n = (long)capw * caph;
+  long rs = 3L * capw;
+  int i, j;
+
+  if (!capy4m) {
+    for (j = 0; j < caph; j++) {
+      const unsigned char *r = rgb + (capflip ? caph - 1 - j : j) * rs;
+      if (fwrite(r, 1, rs, capfile) != (size_t)rs) return false;
     }
+    return true;
+  }
 
-    copybuffercr(fftcur, na);
+  for (j = 0; j < caph; j++) {
+    const unsigned char *r = rgb + (capflip ? caph - 1 - j : j) * rs;
+    unsigned char *y = yuv + (long)j * capw;
+    for (i = 0; i < capw; i++, r += 3) {
+      int R = r[0], G = r[1], B = r[2];
+      y[i] = (unsigned char)(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+      y[i + n] =
+          (unsigned char)(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+      y[i + 2 * n] =
+          (unsigned char)(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+    }
   }
+  return fputs("FRAME\n", capfile) >= 0 &&
+         fwrite(yuv, 1, 3 * n, capfile) == (size_t)(3 * n);
 }
 
-// multiply with kernel (Fourier buffers), scale
+// writer thread of the capture, takes the mapped frames of the ring in order
 //
-void kernelmul(int vo, int ke, int na, double sc) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, NX / 2 + 1, 0, NY, -NZ, NZ);
-  glViewport(0, 0, NX / 2 + 1, NY);
+void *capturethread(void *) {
+  unsigned char *yuv =
+      capy4m ? (unsigned char *)calloc(3L * capw * caph, 1) : 0;
+  bool ok = !capy4m || yuv;
+  int w = 0;
 
-  glBindFramebuffer(GL_FRAMEBUFFER, fb[na]);
-  glUseProgram(shader_kernelmul);
-  glUniform1f(loc_sc, (float)sc);
+  for (;;) {
+    pthread_mutex_lock(&capmutex);
+    while (capring[w].state != CAPMAPPED && !capquit)
+      pthread_cond_wait(&capcond, &capmutex);
+    bool quit = capring[w].state != CAPMAPPED;
+    pthread_mutex_unlock(&capmutex);
+    if (quit) break;
+
+    ok = ok && capring[w].data && capturewrite(capring[w].data, yuv);
+
+    pthread_mutex_lock(&capmutex);
+    capring[w].state = CAPDONE;
+    pthread_cond_broadcast(&capcond);
+    pthread_mutex_unlock(&capmutex);
+    w = (w + 1) % CAPRING;
+  }
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(ttd, tb[vo]);
-  glUniform1i(glGetUniformLocation(shader_kernelmul, "tex0"), 0);
+  free(yuv);
+  pthread_mutex_lock(&capmutex);
+  capok = ok;
+  pthread_mutex_unlock(&capmutex);
+  return 0;
+}
 
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(ttd, tb[ke]);
-  glUniform1i(glGetUniformLocation(shader_kernelmul, "tex1"), 1);
+int capstate(const capframe *f) {
+  pthread_mutex_lock(&capmutex);
+  int state = f->state;
+  pthread_mutex_unlock(&capmutex);
+  return state;
+}
 
-  if (dims == 1) {
-    glFramebufferTexture1D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_1D,
-                           tb[na], 0);
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, 0);
-    glMultiTexCoord1d(GL_TEXTURE1, 0);
-    glVertex2d(0, 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, 1);
-    glMultiTexCoord1d(GL_TEXTURE1, 1);
-    glVertex2d(NX / 2 + 1, 0.5);
-    glEnd();
-  } else if (dims == 2) {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           tb[na], 0);
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 0);
-    glVertex2i(0, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 1, 0);
-    glVertex2i(NX / 2 + 1, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 1, 1);
-    glVertex2i(NX / 2 + 1, NY);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 1);
-    glVertex2i(0, NY);
-    glEnd();
-  } else  // dims==3
-  {
-    for (int t = 0; t < NZ; t++) {
-      double l = (t + 0.5) / NZ;
-      glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                             GL_TEXTURE_3D, tb[na], 0, t);
-      glBegin(GL_QUADS);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 0, l);
-      glVertex3i(0, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1, 0, l);
-      glVertex3i(NX / 2 + 1, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1, 1, l);
-      glVertex3i(NX / 2 + 1, NY, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 1, l);
-      glVertex3i(0, NY, t);
-      glEnd();
+// once per frame: map the frames the GPU has read back for the writer thread,
+// unmap the written ones
+//
+void capturepoll(void) {
+  if (!capturing) return;
+
+  for (int i = 0; i < CAPRING; i++) {
+    capframe *f = &capring[i];
+    int state = capstate(f);
+
+    if (state == CAPREAD) {
+      if (glClientWaitSync(f->fence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+      glDeleteSync(f->fence);
+      f->fence = 0;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, f->pbo);
+      f->data = (unsigned char *)glMapBufferRange(
+          GL_PIXEL_PACK_BUFFER, 0, 3L * capw * caph, GL_MAP_READ_BIT);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      pthread_mutex_lock(&capmutex);
+      f->state = CAPMAPPED;  // also if mapping failed, the writer keeps order
+      pthread_cond_broadcast(&capcond);
+      pthread_mutex_unlock(&capmutex);
+    } else if (state == CAPDONE) {
+      if (f->data) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, f->pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        f->data = 0;
+      }
+      pthread_mutex_lock(&capmutex);
+      f->state = CAPFREE;
+      pthread_mutex_unlock(&capmutex);
     }
   }
+}
 
-  glUseProgram(0);
+// wait until frame f of the ring is free, sleeping on the GPU or the writer
+//
+void capturewaitframe(capframe *f) {
+  for (;;) {
+    capturepoll();
+    pthread_mutex_lock(&capmutex);
+    int state = f->state;
+    if (state == CAPMAPPED) pthread_cond_wait(&capcond, &capmutex);
+    pthread_mutex_unlock(&capmutex);
+    if (state == CAPFREE) return;
+    if (state == CAPREAD)
+      glClientWaitSync(f->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  }
 }
 
-// apply the snm function (real buffers)
+// end the recording, waits for the frames still in the ring
 //
-void snm(int an, int am, int na) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0, NX, 0, NY, -NZ, NZ);
-  glViewport(0, 0, NX, NY);
+void capturestop(void) {
+  int i;
 
-  glBindFramebuffer(GL_FRAMEBUFFER, fr[na]);
-  glUseProgram(shader_snm);
-  glUniform1f(loc_mode, (float)mode);
-  glUniform1f(loc_dt, (float)dt);
-  glUniform1f(loc_b1, (float)b1);
-  glUniform1f(loc_b2, (float)b2);
-  glUniform1f(loc_d1, (float)d1);
-  glUniform1f(loc_d2, (float)d2);
-  glUniform1f(loc_sigmode, (float)sigmode);
-  glUniform1f(loc_sigtype, (float)sigtype);
-  glUniform1f(loc_mixtype, (float)mixtype);
-  glUniform1f(loc_sn, (float)sn);
-  glUniform1f(loc_sm, (float)sm);
+  if (!capturing) return;
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(ttd, tr[an]);
-  glUniform1i(glGetUniformLocation(shader_snm, "tex0"), 0);
+  for (i = 0; i < CAPRING; i++) capturewaitframe(&capring[i]);
 
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(ttd, tr[am]);
-  glUniform1i(glGetUniformLocation(shader_snm, "tex1"), 1);
+  pthread_mutex_lock(&capmutex);
+  capquit = true;
+  pthread_cond_broadcast(&capcond);
+  pthread_mutex_unlock(&capmutex);
+  pthread_join(capthread, 0);
 
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(ttd, tr[na]);
-  glUniform1i(glGetUniformLocation(shader_snm, "tex2"), 2);
+  bool ok = capok;
+  if (cappipe)
+    ok = pclose(capfile) == 0 && ok;
+  else
+    ok = fclose(capfile) == 0 && ok;
+  capfile = 0;
+  capturing = false;
 
-  if (dims == 1) {
-    glFramebufferTexture1D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_1D,
-                           tr[na], 0);
-    glBegin(GL_LINES);
-    glMultiTexCoord1d(GL_TEXTURE0, 0);
-    glMultiTexCoord1d(GL_TEXTURE1, 0);
-    glMultiTexCoord2d(GL_TEXTURE2, 0, 0);
-    glVertex2d(0, 0.5);
-    glMultiTexCoord1d(GL_TEXTURE0, 1);
-    glMultiTexCoord1d(GL_TEXTURE1, 1);
-    glMultiTexCoord2d(GL_TEXTURE2, 1, 0);
-    glVertex2d(NX, 0.5);
-    glEnd();
-  } else if (dims == 2) {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           tr[na], 0);
-    glBegin(GL_QUADS);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 0);
-    glMultiTexCoord2d(GL_TEXTURE2, 0, 0);
-    glVertex2i(0, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1, 0);
-    glMultiTexCoord2d(GL_TEXTURE1, 1, 0);
-    glMultiTexCoord2d(GL_TEXTURE2, 1, 0);
-    glVertex2i(NX, 0);
-    glMultiTexCoord2d(GL_TEXTURE0, 1, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 1, 1);
-    glMultiTexCoord2d(GL_TEXTURE2, 1, 1);
-    glVertex2i(NX, NY);
-    glMultiTexCoord2d(GL_TEXTURE0, 0, 1);
-    glMultiTexCoord2d(GL_TEXTURE1, 0, 1);
-    glMultiTexCoord2d(GL_TEXTURE2, 0, 1);
-    glVertex2i(0, NY);
-    glEnd();
-  } else  // dims==3
-  {
-    for (int t = 0; t < NZ; t++) {
-      double l = (t + 0.5) / NZ;
-      glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                             GL_TEXTURE_3D, tr[na], 0, t);
-      glBegin(GL_QUADS);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE2, 0, 0, l);
-      glVertex3i(0, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1, 0, l);
-      glMultiTexCoord3d(GL_TEXTURE2, 1, 0, l);
-      glVertex3i(NX, 0, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 1, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 1, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE2, 1, 1, l);
-      glVertex3i(NX, NY, t);
-      glMultiTexCoord3d(GL_TEXTURE0, 0, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE1, 0, 1, l);
-      glMultiTexCoord3d(GL_TEXTURE2, 0, 1, l);
-      glVertex3i(0, NY, t);
-      glEnd();
-    }
+  for (i = 0; i < CAPRING; i++) glDeleteBuffers(1, &capring[i].pbo);
+  memset(capring, 0, sizeof(capring));
+
+  fprintf(logfile, "capture %d x %d: %ld frames, %ld waits for the ring %s\n",
+          capw, caph, capframes, capwaits, ok ? "written" : "failed");
+  fflush(logfile);
+}
+
+// start recording every capevery-th time step to CAPFILE (or the file or
+// "|command" in SMOOTHLIFE_CAPTURE), a y4m stream unless the name ends in
+// .raw, then raw rgb24 frames; 2D records the whole buffer, 1D and 3D the
+// window
+//
+void capturestart(void) {
+  const char *name = getenv("SMOOTHLIFE_CAPTURE");
+  int i;
+
+  if (name == 0 || *name == 0) name = CAPFILE;
+  long len = strlen(name);
+
+  capw = dims == 2 ? NX : SX;
+  caph = dims == 2 ? NY : SY;
+  capflip = dims != 2;
+  cappipe = name[0] == '|';
+  capy4m = !(len >= 4 && strcmp(name + len - 4, ".raw") == 0);
+
+  capfile = cappipe ? popen(name + 1, "w") : fopen(name, "wb");
+  if (capfile == 0) {
+    fprintf(logfile, "capture %s failed\n", name);
+    fflush(logfile);
+    return;
+  }
+  if (capy4m)
+    fprintf(capfile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", capw, caph,
+            CAPFPS);
+
+  for (i = 0; i < CAPRING; i++) {
+    glGenBuffers(1, &capring[i].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capring[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, 3L * capw * caph, 0, GL_STREAM_READ);
+    capring[i].fence = 0;
+    capring[i].data = 0;
+    capring[i].state = CAPFREE;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  capnext = 0;
+  capframes = 0;
+  capwaits = 0;
+  capquit = false;
+  capok = true;
+  capturing = true;
+  if (pthread_create(&capthread, NULL, capturethread, NULL) != 0) {
+    capturing = false;
+    if (cappipe)
+      pclose(capfile);
+    else
+      fclose(capfile);
+    capfile = 0;
+    for (i = 0; i < CAPRING; i++) glDeleteBuffers(1, &capring[i].pbo);
+    memset(capring, 0, sizeof(capring));
+    fprintf(logfile, "capture thread failed\n");
+    fflush(logfile);
+    return;
   }
 
-  glUseProgram(0);
+  fprintf(logfile, "capture %s %d x %d every %d steps%s\n", name, capw, caph,
+          capevery, capy4m ? " y4m" : " rgb24");
+  fflush(logfile);
 }
 
-// initialize an and am with 0 to 1 gradient for drawing of snm (2D only)
+// record the current AA (2D) or window (1D, 3D, after drawa) into the next
+// frame of the ring, the readback overlaps the following time steps, waits
+// only if all CAPRING frames are still being read back or written
 //
-void initan(int a) {
-  float *buf = (float *)calloc(NX * NY, sizeof(float));
+void capturestep(void) {
+  if ((dims == 2 ? NX : SX) != capw || (dims == 2 ? NY : SY) != caph ||
+      (dims != 2) != capflip) {
+    capturestop();
+    savedispcnt = 2.0;
+    sprintf(dispmessage, " capture stopped, new size ");
+    return;
+  }
 
-  int x, y;
+  capframe *f = &capring[capnext];
+  if (capstate(f) != CAPFREE) {
+    capwaits++;
+    capturewaitframe(f);
+  }
 
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++) {
-      buf[y * NX + x] = (float)x / NX;
+  timerclass(TDRAW, (long)capw * caph * 8);
+  if (dims == 2) {
+    if (spfb == 0) create_render_buffer();  // kept until delete_buffers
+    drawa_render_buffer(AA);
+  } else
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);  // back buffer drawn by drawa
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, f->pbo);
+  glReadPixels(0, 0, capw, caph, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  f->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  pthread_mutex_lock(&capmutex);
+  f->state = CAPREAD;
+  pthread_mutex_unlock(&capmutex);
+  capnext = (capnext + 1) % CAPRING;
+  capframes++;
+}
+
+// read the next slab of the 3D export from the snapshot into a free pixel
+// buffer of the ring, 8 and 16 bits are quantized by the readback
+//
+void exportissue(void) {
+  exportslab *e = &exring[(exhead + exinflight) % EXPORTRING];
+  GLenum type = exbits == 8    ? GL_UNSIGNED_BYTE
+                : exbits == 16 ? GL_UNSIGNED_SHORT
+                               : GL_FLOAT;
+  long slice = (long)exnx * exny * (exbits / 8);
+
+  e->z0 = exz;
+  e->nz = exnz - exz < EXPORTSLAB ? exnz - exz : EXPORTSLAB;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, exfb);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, e->pbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  for (int z = 0; z < e->nz; z++) {
+    glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_3D, extex, 0, e->z0 + z);
+    glReadPixels(0, 0, exnx, exny, GL_RED, type, (void *)(z * slice));
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  e->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  exz += e->nz;
+  exinflight++;
+}
+
+// free the snapshot and the ring, close the file
+//
+void exportend(bool ok) {
+  for (int i = 0; i < EXPORTRING; i++) {
+    if (exring[i].fence) glDeleteSync(exring[i].fence);
+    glDeleteBuffers(1, &exring[i].pbo);
+  }
+  memset(exring, 0, sizeof(exring));
+  glDeleteFramebuffers(1, &exfb);
+  glDeleteTextures(1, &extex);
+  exfb = 0;
+  extex = 0;
+  ok = fclose(exfile) == 0 && ok;
+  exfile = 0;
+  exporting = false;
+
+  fprintf(logfile, "export %s %d x %d x %d %d bits %s in %ld ms\n", exname,
+          exnx, exny, exnz, exbits, ok ? "written" : "failed",
+          (long)(SDL_GetTicks() - exticks));
+  fflush(logfile);
+}
+
+// once per frame: write the slabs the GPU has read back in order and refill
+// the ring, wait blocks until the oldest slab is there (program end)
+//
+void exportpoll(bool wait) {
+  bool ok = true;
+
+  if (!exporting) return;
+
+  while (exinflight > 0) {
+    exportslab *e = &exring[exhead];
+    GLenum r = glClientWaitSync(e->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                wait ? 1000000000 : 0);
+    if (r == GL_TIMEOUT_EXPIRED) {
+      if (wait) continue;
+      break;
     }
+    glDeleteSync(e->fence);
+    e->fence = 0;
+
+    long bytes = (long)exnx * exny * e->nz * (exbits / 8);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, e->pbo);
+    void *data =
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    ok = data && fwrite(data, 1, bytes, exfile) == (size_t)bytes;
+    if (data) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    exhead = (exhead + 1) % EXPORTRING;
+    exinflight--;
+    if (!ok) break;
+
+    if (exz < exnz) exportissue();
+  }
 
-  glBindTexture(GL_TEXTURE_2D, tr[a]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, GL_RED, GL_FLOAT, buf);
+  if (!ok || (exinflight == 0 && exz == exnz)) exportend(ok);
+}
 
-  free(buf);
+// start exporting the 3D AA to SmoothLifeNN.nrrd (a raw volume after a
+// short text header, read by ParaView, 3D Slicer, Fiji, ...) without
+// stalling the time steps: AA is copied on the GPU, the copy is read back
+// and written slab by slab by exportpoll, so at most EXPORTRING slabs are
+// in host memory
+//
+void exportstart(void) {
+  static int volnr = 1;
+  int i, z;
+
+  if (exporting || dims != 3) return;
+
+  exbits = exportbits;
+  exnx = NX;
+  exny = NY;
+  exnz = NZ;
+  sprintf(exname, "SmoothLife%02d.nrrd", volnr);
+  exfile = fopen(exname, "wb");
+  if (exfile == 0) {
+    fprintf(logfile, "export %s failed\n", exname);
+    fflush(logfile);
+    return;
+  }
+  volnr++;
+
+  fprintf(exfile, "NRRD0004\n");
+  fprintf(exfile, "# SmoothLife step %ld seed %u\n", stepnr, seed);
+  fprintf(exfile,
+          "# mode %d ra %f rr %f rb %f dt %f b1 %f b2 %f d1 %f d2 %f "
+          "sigmode %d sigtype %d mixtype %d sn %f sm %f\n",
+          (int)mode, ra, rr, rb, dt, b1, b2, d1, d2, (int)sigmode,
+          (int)sigtype, (int)mixtype, sn, sm);
+  fprintf(exfile, "type: %s\n",
+          exbits == 8 ? "uint8" : exbits == 16 ? "uint16" : "float");
+  fprintf(exfile, "dimension: 3\n");
+  fprintf(exfile, "sizes: %d %d %d\n", exnx, exny, exnz);
+  fprintf(exfile, "encoding: raw\n");
+  if (exbits > 8) fprintf(exfile, "endian: little\n");
+  fprintf(exfile, "\n");
+
+  // snapshot, the time steps go on while the slabs are read back
+  glGenTextures(1, &extex);
+  glBindTexture(GL_TEXTURE_3D, extex);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, exnx, exny, exnz, 0, GL_RED,
+               GL_FLOAT, NULL);
+  glGenFramebuffers(1, &exfb);
+  glBindFramebuffer(GL_FRAMEBUFFER, exfb);
+  for (z = 0; z < exnz; z++) {
+    glFramebufferTexture3D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_3D, tr[AA], 0, z);
+    glCopyTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, z, 0, 0, exnx, exny);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindTexture(GL_TEXTURE_3D, 0);
+
+  for (i = 0; i < EXPORTRING; i++) {
+    glGenBuffers(1, &exring[i].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, exring[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER,
+                 (long)exnx * exny * EXPORTSLAB * (exbits / 8), 0,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  exhead = 0;
+  exinflight = 0;
+  exz = 0;
+  exticks = SDL_GetTicks();
+  exporting = true;
+  while (exinflight < EXPORTRING && exz < exnz) exportissue();
 }
 
-void initam(int a) {
-  float *buf = (float *)calloc(NX * NY, sizeof(float));
+// do the time steps of one frame: stepsperframe, as many as fit in FRAMEMS
+// (adaptive) or, in turbo mode, in TURBOMS without drawing; in 1D each step
+// draws its row, captures of the window draw it anew
+//
+void timesteps(void) {
+  bool measure = stepsperframe == 0 || turbo > 0;
+  unsigned long t0 = 0;
+  int n = stepsperframe;
+
+  if (measure) {
+    n = (int)((turbo > 0 ? TURBOMS : FRAMEMS) / stepms);
+    if (turbo == 0 && n > MAXSTEPS) n = MAXSTEPS;
+    if (turbo > 0 && n > turbo) n = (int)turbo;
+    if (n < 1) n = 1;
+    glFinish();
+    t0 = SDL_GetTicks();
+  }
 
-  int x, y;
+  for (int k = 0; k < n; k++) {
+    if (k > 0 && dims == 1 && turbo == 0) drawa(AA);
+    if (capturing && stepnr % capevery == 0) {
+      if (dims != 2 && (k > 0 || turbo > 0)) drawa(AA);
+      capturestep();
+    }
+    timestep();
+    stepnr++;
+    phase += dphase;
+    ypos++;
+    if (ypos >= SY) ypos = 0;
+  }
+  framesteps = n;
 
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++) {
-      buf[y * NX + x] = (float)y / NY;
+  if (measure) {
+    glFinish();
+    double ms = (double)(SDL_GetTicks() - t0);
+    if (ms < 1.0) ms = 1.0;  // ticks are ms
+    stepms = 0.5 * stepms + 0.5 * ms / n;
+  }
+
+  if (turbo > 0) {
+    turbo -= n;
+    if (turbo <= 0) {
+      turbo = 0;
+      savedispcnt = 2.0;
+      sprintf(dispmessage, " turbo done, step %ld ", stepnr);
     }
+  }
+}
 
-  glBindTexture(GL_TEXTURE_2D, tr[a]);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, GL_RED, GL_FLOAT, buf);
+// recreate the buffers at the current size (after a change of halfbufs)
+//
+bool rebuild_buffers(void) {
+  delete_buffers();
+  if (!create_buffers()) return false;
+  fft_planx();
+  if (dims > 1) fft_plany();
+  if (dims > 2) fft_planz();
+  newsteps();
+  return true;
+}
 
-  free(buf);
+// recreate the Fourier buffers after a change of packed, the step needs
+// other ones (see planbuffers), AA stays
+//
+bool replan_fourier(void) {
+  delete_fourier();
+  planbuffers();
+  if (!create_fourier()) return false;
+  kernelspectra();
+  newsteps();
+  return true;
 }
 
-// draw snm function into buffer (2D only)
+// PRECSTEPS time steps of paras p from the blobs of PRECSEED with the buffer
+// storage half (halfbufs), AA is read back into a
 //
-void makesnm(int an, int am, int asnm) {
-  initan(an);
-  initam(am);
-  snm(an, am, asnm);
+bool precisionrun(const struct parameterlist &p, int half, float *a) {
+  halfbufs = half;
+  if (!rebuild_buffers()) return false;
+  putparas(p);
+  if (setsnmvariant()) return false;
+  kernelspectra();
+  initaseed(AA, PRECSEED);
+  for (int t = 0; t < PRECSTEPS; t++) timestep();
+
+  glBindTexture(ttd, tr[AA]);
+  glGetTexImage(ttd, 0, GL_RED, GL_FLOAT, a);
+  glBindTexture(ttd, 0);
+  return true;
+}
+
+// run all paras of the list with the current dims and size, once with float
+// buffers and once with each half float storage, and write how far the half
+// float runs get from the float one to PRECFILE: mean of the buffer, max and
+// mean difference per cell, and the smallest storage whose buffer mean stays
+// within PRECTOL of the float one (chaotic rules drift apart cell by cell
+// with any rounding, so only the mean tells if a rule survives), the buffers
+// start anew afterwards
+//
+void precisionreport(void) {
+  long n = (long)NX * NY * NZ;
+  float *a = (float *)calloc(n, sizeof(float));
+  float *h = (float *)calloc(n, sizeof(float));
+  FILE *fp = fopen(PRECFILE, "w");
+  struct parameterlist cur;
+  int half = halfbufs;
+  int runs = 0;
+
+  getparas(cur);
+  if (a && h && fp) {
+    fprintf(fp, "# %dD %dx%dx%d, %d time steps from the blobs of seed %u\n",
+            dims, NX, NY, NZ, PRECSTEPS, PRECSEED);
+    fprintf(fp,
+            "# paras   float  |  mixed: mean  maxdiff meandiff |"
+            "   half: mean  maxdiff meandiff |  ok with\n");
+    for (int l = 0; l < nparas; l++) {
+      if (paralist[l].dims != dims) continue;
+      if (!precisionrun(paralist[l], 0, a)) break;
+
+      double ma = 0.0;
+      for (long i = 0; i < n; i++) ma += a[i];
+      fprintf(fp, "%7d %7.4f  |", l, ma / n);
+
+      static const char *okname[3] = {"float", "mixed", "half"};
+      int ok = 0;
+      for (int m = 1; m <= 2; m++) {
+        if (!precisionrun(paralist[l], m, h)) break;
+        double mh = 0.0, dmax = 0.0, dsum = 0.0;
+        for (long i = 0; i < n; i++) {
+          double d = fabs(h[i] - a[i]);
+          mh += h[i];
+          dsum += d;
+          if (d > dmax) dmax = d;
+        }
+        fprintf(fp, "  %11.4f %8.4f %8.4f |", mh / n, dmax, dsum / n);
+        double mmax = (mh > ma ? mh : ma) / n;
+        if (mmax < PRECMIN) mmax = PRECMIN;
+        if (ok == m - 1 && fabs(mh - ma) / n <= PRECTOL * mmax) ok = m;
+      }
+      fprintf(fp, "  %-5s  %s\n", okname[ok], paralist[l].desc);
+      runs++;
+    }
+    fprintf(logfile, "precision report of %d paras in %s\n", runs, PRECFILE);
+    fflush(logfile);
+  }
+  if (fp) fclose(fp);
+  free(a);
+  free(h);
+
+  halfbufs = half;
+  if (!rebuild_buffers()) {
+    fprintf(logfile, "precision report: no buffers\n");
+    fflush(logfile);
+  }
+  putparas(cur);
+  setsnmvariant();
+  kernelspectra();
+  inita(AA);
+  savedispcnt = 5.0;
+  sprintf(dispmessage, " precision report of %d paras in %s ", runs,
+          PRECFILE);
 }
 
 // window proc
@@ -2176,6 +4374,45 @@ int doevents(void) {
         if (wParam == 'b' || wParam == 'n' || wParam == ' ') inita(AA);
 
         if (wParam == 'p') pause ^= 1;
+        if (wParam == 'P') {
+          packed ^= 1;
+          if (!replan_fourier()) {
+            delete_buffers();
+            neu = true;
+          }
+          savedispcnt = 2.0;
+          sprintf(dispmessage, " packed %d, buffers %.0f MB ", packed,
+                  bufferbytes() / 1048576.0);
+        }
+
+        if (wParam == 'M') {
+          fftcompute ^= 1;
+          newsteps();
+        }
+
+        if (wParam == 'N') {
+          kernelfourier ^= 1;
+          kernelspectra();
+        }
+
+        if (wParam == 'B') {
+          fftradix /= 2;
+          if (fftradix < 2) fftradix = 8;
+          delete_buffers();
+          neu = true;
+        }
+
+        if (wParam == '*') {
+          static const char *name[3] = {"float", "mixed (half spectra)",
+                                        "half (spectra, AA, AN, AM)"};
+          halfbufs = (halfbufs + 1) % 3;
+          delete_buffers();
+          neu = true;
+          savedispcnt = 5.0;
+          sprintf(dispmessage, " buffers %s ", name[halfbufs]);
+        }
+
+        if (wParam == '#') precisionreport();
 
         if (wParam == '(' || wParam == ')') {
           if (wParam == '(') curparas--;
@@ -2250,18 +4487,19 @@ int doevents(void) {
         if (wParam == '3') mode = 3;
         if (wParam == '4') mode = 4;
 
+        // switch to the snm variant for the new sigmode, sigtype, mixtype
+        // or mode
+        if (wParam > 0 && wParam < 128 && strchr("tgzhuj01234", wParam))
+          setsnmvariant();
+
         if (wParam == 'T') {
           ra += 0.1;
-          makekernel(KR, KD);
-          fft(KR, KRF, -1);
-          fft(KD, KDF, -1);
+          kernelspectra();
         }
         if (wParam == 'G') {
           ra -= 0.1;
           if (ra < 1.0) ra = 1.0;
-          makekernel(KR, KD);
-          fft(KR, KRF, -1);
-          fft(KD, KDF, -1);
+          kernelspectra();
         }
 
         if (wParam == 'Z') dt += 0.001;
@@ -2274,31 +4512,26 @@ int doevents(void) {
           if (wParam == '5') {
             delete_buffers();
             NX = 512;
-            BX = 9;
             neu = true;
           }
           if (wParam == '6') {
             delete_buffers();
             NX = 1024;
-            BX = 10;
             neu = true;
           }
           if (wParam == '7') {
             delete_buffers();
             NX = 2048;
-            BX = 11;
             neu = true;
           }
           if (wParam == '8') {
             delete_buffers();
             NX = 4096;
-            BX = 12;
             neu = true;
           }
           if (wParam == '9') {
             delete_buffers();
             NX = 8192;
-            BX = 13;
             neu = true;
           }
         } else if (dims == 2) {
@@ -2306,40 +4539,30 @@ int doevents(void) {
             delete_buffers();
             NX = 128;
             NY = 128;
-            BX = 7;
-            BY = 7;
             neu = true;
           }
           if (wParam == '6') {
             delete_buffers();
             NX = 256;
             NY = 256;
-            BX = 8;
-            BY = 8;
             neu = true;
           }
           if (wParam == '7') {
             delete_buffers();
             NX = 512;
             NY = 512;
-            BX = 9;
-            BY = 9;
             neu = true;
           }
           if (wParam == '8') {
             delete_buffers();
             NX = 1024;
             NY = 1024;
-            BX = 10;
-            BY = 10;
             neu = true;
           }
           if (wParam == '9') {
             delete_buffers();
             NX = 2048;
             NY = 2048;
-            BX = 11;
-            BY = 11;
             neu = true;
           }
         } else  // dims==3
@@ -2349,9 +4572,6 @@ int doevents(void) {
             NX = 32;
             NY = 32;
             NZ = 32;
-            BX = 5;
-            BY = 5;
-            BZ = 5;
             neu = true;
           }
           if (wParam == '6') {
@@ -2359,9 +4579,6 @@ int doevents(void) {
             NX = 64;
             NY = 64;
             NZ = 64;
-            BX = 6;
-            BY = 6;
-            BZ = 6;
             neu = true;
           }
           if (wParam == '7') {
@@ -2369,9 +4586,6 @@ int doevents(void) {
             NX = 128;
             NY = 128;
             NZ = 128;
-            BX = 7;
-            BY = 7;
-            BZ = 7;
             neu = true;
           }
           if (wParam == '8') {
@@ -2379,9 +4593,6 @@ int doevents(void) {
             NX = 256;
             NY = 256;
             NZ = 256;
-            BX = 8;
-            BY = 8;
-            BZ = 8;
             neu = true;
           }
           if (wParam == '9') {
@@ -2389,9 +4600,21 @@ int doevents(void) {
             NX = 512;
             NY = 512;
             NZ = 512;
-            BX = 9;
-            BY = 9;
-            BZ = 9;
+            neu = true;
+          }
+        }
+
+        if (wParam == '<' || wParam == '>') {
+          int dir = wParam == '>' ? 1 : -1;
+          int m = NX;
+          if (dims == 1) m = nextsize(NX, dir, 64, 8192);
+          if (dims == 2) m = nextsize(NX, dir, 64, 2048);
+          if (dims == 3) m = nextsize(NX, dir, 16, 512);
+          if (m != NX) {
+            delete_buffers();
+            NX = m;
+            if (dims > 1) NY = m;
+            if (dims > 2) NZ = m;
             neu = true;
           }
         }
@@ -2436,6 +4659,28 @@ int doevents(void) {
 
         if (wParam == '-') {
           if (dims == 2) mysavepic();
+          if (dims == 3) {
+            exportstart();
+            savedispcnt = 1.0;
+            sprintf(dispmessage, " %s %d bits ", exname, exbits);
+          }
+        }
+
+        if (wParam == 'U') {
+          checkpointsave(CHECKFILE);
+          savedispcnt = 1.0;
+          sprintf(dispmessage, " checkpoint step %ld ", stepnr);
+        }
+
+        if (wParam == 'J') {
+          if (checkpointload(CHECKFILE)) {
+            neuedim = true;
+            delShaders();
+            delete_buffers();
+            sprintf(dispmessage, " restored step %ld ", rshead.stepnr);
+          } else
+            sprintf(dispmessage, " no checkpoint ");
+          savedispcnt = 2.0;
         }
 
         if (wParam == '.') {
@@ -2478,6 +4723,45 @@ int doevents(void) {
           dphase += 0.000001 * pow(10, dims);  // color phase speed
         if (sym == SDLK_F4) dphase -= 0.000001 * pow(10, dims);
 
+        if (sym == SDLK_F8) {
+          if (capturing)
+            capturestop();
+          else
+            capturestart();
+          savedispcnt = 2.0;
+          if (capturing)
+            sprintf(dispmessage, " recording every %d steps ", capevery);
+          else
+            sprintf(dispmessage, " recorded %ld frames ", capframes);
+        }
+        if (sym == SDLK_F9) {
+          capevery = capevery < 64 ? 2 * capevery : 1;
+          savedispcnt = 1.0;
+          sprintf(dispmessage, " record every %d steps ", capevery);
+        }
+
+        if (sym == SDLK_F10) {
+          exportbits = exportbits == 8 ? 16 : exportbits == 16 ? 32 : 8;
+          savedispcnt = 1.0;
+          sprintf(dispmessage, " export %d bits ", exportbits);
+        }
+
+        if (sym == SDLK_F11) {
+          stepsperframe = stepsperframe == 0    ? 1
+                          : stepsperframe < 64 ? 2 * stepsperframe
+                                               : 0;
+          savedispcnt = 1.0;
+          if (stepsperframe)
+            sprintf(dispmessage, " %d steps per frame ", stepsperframe);
+          else
+            sprintf(dispmessage, " adaptive steps per frame ");
+        }
+        if (sym == SDLK_F12) {
+          turbo = turbo > 0 ? 0 : TURBOSTEPS;
+          savedispcnt = 1.0;
+          sprintf(dispmessage, " turbo %ld steps ", turbo);
+        }
+
         if (sym == SDLK_F5) {
           dims = 1;
           neuedim = true;
@@ -2581,6 +4865,25 @@ void drawtext(double ln, char *text) {
   }
 }
 
+// GPU time and bytes per frame of each pass class, from the top of the window
+//
+void drawtimers(void) {
+  char buf[128];
+  double sum = 0.0;
+  int c, l = 1;
+
+  for (c = 0; c < TCLASSES; c++) sum += tms[c];
+  sprintf(buf, " gpu %.2f ms per frame ", sum);
+  drawtext(SY / 20 - l++, buf);
+
+  for (c = 0; c < TCLASSES; c++) {
+    if (tms[c] < 0.0005) continue;
+    sprintf(buf, " %-9s %7.2f ms %8.1f MB %7.1f GB/s ", tclassname[c], tms[c],
+            tbytes[c] / 1e6, tbytes[c] / (tms[c] * 1e6));
+    drawtext(SY / 20 - l++, buf);
+  }
+}
+
 // make a small texture for every single character
 //
 void makefonttextures(TTF_Font *font) {
@@ -2701,9 +5004,25 @@ int main(int argc, char *argv[]) {
   str = glGetString(GL_VERSION);
   fprintf(logfile, "glversion %s\n", str);
   fflush(logfile);
+  {
+    int ma = 0, mi = 0;
+    if (str) sscanf((const char *)str, "%d.%d", &ma, &mi);
+    computeok = ma > 4 || (ma == 4 && mi >= 3);
+    clearok = ma > 4 || (ma == 4 && mi >= 4);
+    timerok = ma > 3 || (ma == 3 && mi >= 3);
+  }
   str = glGetString(GL_SHADING_LANGUAGE_VERSION);
   fprintf(logfile, "glslversion %s\n", str);
   fflush(logfile);
+  str = glGetString(GL_EXTENSIONS);
+  layered = str && (strstr((const char *)str, "GL_AMD_vertex_shader_layer") ||
+                    strstr((const char *)str,
+                           "GL_ARB_shader_viewport_layer_array"));
+  fprintf(logfile, "layered 3D passes %d\n", layered);
+  fflush(logfile);
+
+  cputhreads_init(0);  // for building the kernels
+  timerstart();        // SMOOTHLIFE_TRACE
 
   // wglSwapIntervalEXT (0);		// switch off vsync (windows only, comment out
   // else)
@@ -2715,6 +5034,11 @@ int main(int argc, char *argv[]) {
   visscheme = 2;
   anz = 1;
   pause = 0;
+  packed = 1;
+  fftradix = 8;
+  fftcompute = 0;
+  kernelfourier = 0;
+  halfbufs = 0;
   ox = 10;
   oy = 70;
   phase = 0.0;
@@ -2729,6 +5053,11 @@ int main(int argc, char *argv[]) {
   dw = 0.0;
   curparas = 0;
   setparas(curparas);
+  cklast = SDL_GetTicks();
+  if (argc > 1 && !checkpointload(argv[1])) {  // smooth file.slc restores it
+    fprintf(logfile, "couldn't restore %s\n", argv[1]);
+    fflush(logfile);
+  }
 
 // dimension has changed, keys '(' and ')', or f5/f6/f7
 neuedim:
@@ -2743,30 +5072,57 @@ neuedim:
   if (setShaders(dims, (char *)"copybuffercr", shader_copybuffercr)) goto ende;
   if (setShaders(dims, (char *)"fft", shader_fft)) goto ende;
   if (setShaders(dims, (char *)"kernelmul", shader_kernelmul)) goto ende;
-  if (setShaders(dims, (char *)"snm", shader_snm)) goto ende;
+  if (setShaders(dims, (char *)"copybuffercr", shader_copybuffercr4,
+                 "#define FOUR\n"))
+    goto ende;
+  if (setShaders(dims, (char *)"fft", shader_fft4, "#define FOUR\n"))
+    goto ende;
+  if (setShaders(dims, (char *)"kernelmul", shader_kernelmul4,
+                 "#define FOUR\n"))
+    goto ende;
+  if (setsnmvariant()) goto ende;
   if (setShaders(dims, (char *)"draw", shader_draw)) goto ende;
 
+  // compute shader FFT, the fragment passes are used if it doesn't compile
+  // (a variant for the image formats of each halfbufs)
+  if (computeok) {
+    static const char *fmts[3] = {"", "#define HALF\n",
+                                  "#define HALF\n#define RHALF\n"};
+    char consts[96];
+    for (int v = 0; v < 3; v++) {
+      sprintf(consts, "%s#define NMAX %d\n", fmts[v], FFTCMAX);
+      if (!setComputeShader(dims, (char *)"fft", shader_fftc[v], consts))
+        fftc_locations(shader_fftc[v], loc_fftc[v]);
+      sprintf(consts, "%s#define FOUR\n#define NMAX %d\n", fmts[v], FFTCMAX);
+      if (!setComputeShader(dims, (char *)"fft", shader_fftc4[v], consts))
+        fftc_locations(shader_fftc4[v], loc_fftc4[v]);
+    }
+  }
+
   loc_dim = glGetUniformLocation(shader_fft, "dim");
   loc_tang = glGetUniformLocation(shader_fft, "tang");
   loc_tangsc = glGetUniformLocation(shader_fft, "tangsc");
+  loc_radix = glGetUniformLocation(shader_fft, "radix");
 
   loc_sc = glGetUniformLocation(shader_kernelmul, "sc");
 
-  loc_mode = glGetUniformLocation(shader_snm, "mode");
-  loc_dt = glGetUniformLocation(shader_snm, "dt");
-  loc_b1 = glGetUniformLocation(shader_snm, "b1");
-  loc_b2 = glGetUniformLocation(shader_snm, "b2");
-  loc_d1 = glGetUniformLocation(shader_snm, "d1");
-  loc_d2 = glGetUniformLocation(shader_snm, "d2");
-  loc_sigmode = glGetUniformLocation(shader_snm, "sigmode");
-  loc_sigtype = glGetUniformLocation(shader_snm, "sigtype");
-  loc_mixtype = glGetUniformLocation(shader_snm, "mixtype");
-  loc_sn = glGetUniformLocation(shader_snm, "sn");
-  loc_sm = glGetUniformLocation(shader_snm, "sm");
+  loc_dim4 = glGetUniformLocation(shader_fft4, "dim");
+  loc_tang4 = glGetUniformLocation(shader_fft4, "tang");
+  loc_tangsc4 = glGetUniformLocation(shader_fft4, "tangsc");
+  loc_radix4 = glGetUniformLocation(shader_fft4, "radix");
+
+  loc_sc4 = glGetUniformLocation(shader_kernelmul4, "sc");
 
   loc_colscheme = glGetUniformLocation(shader_draw, "colscheme");
   loc_phase = glGetUniformLocation(shader_draw, "phase");
   loc_visscheme = glGetUniformLocation(shader_draw, "visscheme");
+  loc_tex0 = glGetUniformLocation(shader_draw, "tex0");
+  loc_fx = glGetUniformLocation(shader_draw, "fx");
+  loc_fy = glGetUniformLocation(shader_draw, "fy");
+  loc_fz = glGetUniformLocation(shader_draw, "fz");
+  loc_nx = glGetUniformLocation(shader_draw, "nx");
+  loc_ny = glGetUniformLocation(shader_draw, "ny");
+  loc_nz = glGetUniformLocation(shader_draw, "nz");
 
   glClampColor(GL_CLAMP_FRAGMENT_COLOR, GL_FALSE);
   glClampColor(GL_CLAMP_VERTEX_COLOR, GL_FALSE);
@@ -2777,35 +5133,35 @@ neuedim:
 
   if (dims == 1) {
     NX = 1024;
-    BX = 10;  // 262144, 18
     NY = 1;
-    BY = 0;
     NZ = 1;
-    BZ = 0;
   } else if (dims == 2) {
     NX = 512;
-    BX = 9;
     NY = 512;
-    BY = 9;
     NZ = 1;
-    BZ = 0;
   } else  // dims==3
   {
     NX = 64;
-    BX = 6;
     NY = 64;
-    BY = 6;
     NZ = 64;
-    BZ = 6;
+  }
+  if (rsmap) {  // a checkpoint is being restored
+    NX = rshead.nx;
+    NY = rshead.ny;
+    NZ = rshead.nz;
   }
 
-// buffer size has changed (keys 5,6,7,8,9)
+// buffer size has changed (keys 5,6,7,8,9 and <,>)
 nochmal:
 
+  BX = fft_radices(NX / 2, RX, fftradix) + 1;
+  BY = fft_radices(NY, RY, fftradix);
+  BZ = fft_radices(NZ, RZ, fftradix);
+
   qx = NX;
   qy = NY;
-  if (dims == 1) qq = BX * 16;
-  if (dims == 2) qq = BX * 16;
+  if (dims == 1) qq = (int)(log(NX) / log(2.0) + 0.5) * 16;
+  if (dims == 2) qq = (int)(log(NX) / log(2.0) + 0.5) * 16;
   if (dims == 3) qq = -NX * 3 / 10;
 
   if (!create_buffers()) goto ende;
@@ -2813,11 +5169,10 @@ nochmal:
   fft_planx();
   if (dims > 1) fft_plany();
   if (dims > 2) fft_planz();
-  makekernel(KR, KD);
-  fft(KR, KRF, -1);
-  fft(KD, KDF, -1);
+  kernelspectra();
 
   inita(AA);
+  if (rsmap) checkpointrestore();
 
   neu = false;
   neuedim = false;
@@ -2829,43 +5184,55 @@ nochmal:
     if (neu) goto nochmal;      // new buffer size
     if (neuedim) goto neuedim;  // new parameter set
 
-    if (timing) {
+    kernelpoll();  // kernels of the neighbouring radii built in the background
+    checkpointpoll();
+    capturepoll();
+    exportpoll(false);
+
+    timerframebegin();
+
+    if (timing && !timers) {
       glFlush();
       glFinish();
       tim = SDL_GetTicks();
     }
 
-    if (anz == 1)  // draw buffer and do a time step
+    if (anz == 1 && turbo > 0 && !pause)  // time steps without drawing
+    {
+      timesteps();
+      continue;
+    }
+
+    if (anz == 1)  // draw buffer and do the time steps of a frame
     {
       drawa(AA);
-      if (!pause) {
-        fft(AA, AF, -1);
-        kernelmul(AF, KRF, ANF, sqrt(NX * NY * NZ) / kflr);
-        kernelmul(AF, KDF, AMF, sqrt(NX * NY * NZ) / kfld);
-        fft(ANF, AN, 1);
-        fft(AMF, AM, 1);
-        snm(AN, AM, AA);
-        phase += dphase;
-        ypos++;
-        if (ypos >= SY) ypos = 0;
-      }
+      if (!pause) timesteps();
     } else if (anz == 2)  // draw snm function
     {
       if (dims == 2) makesnm(AN, AM, AA);
       drawa(AA);
     } else if (anz == 3)  // draw disk kernel
     {
+      kernelreals();
       drawa(KD);
     } else if (anz == 4)  // draw ring kernel
     {
+      kernelreals();
       drawa(KR);
     }
 
+    timerframeend();
+
     if (timing)  // show info
     {
-      glFlush();
-      glFinish();
-      tima = SDL_GetTicks();
+      if (timers) {  // frame to frame time, the GPU timers don't stall
+        tim = tima;
+        tima = SDL_GetTicks();
+      } else {
+        glFlush();
+        glFinish();
+        tima = SDL_GetTicks();
+      }
 
       glMatrixMode(GL_PROJECTION);
       glLoadIdentity();
@@ -2898,15 +5265,18 @@ nochmal:
 
       char buf[256];
 
-      sprintf(buf, " %ld  %d   ra=%.1f  rr=%.1f  rb=%.1f  dt=%.3f   %d %d %d ",
-              tima - tim, (int)mode, ra, rr, rb, dt, (int)sigmode, (int)sigtype,
-              (int)mixtype);
+      sprintf(buf,
+              " %ld x%d  %d   ra=%.1f  rr=%.1f  rb=%.1f  dt=%.3f   %d %d %d ",
+              tima - tim, framesteps, (int)mode, ra, rr, rb, dt, (int)sigmode,
+              (int)sigtype, (int)mixtype);
       drawtext(2, buf);
 
       sprintf(buf, " b1=%.3f  b2=%.3f  d1=%.3f  d2=%.3f   sn=%.3f  sm=%.3f ",
               b1, b2, d1, d2, sn, sm);
       drawtext(1, buf);
 
+      if (timers) drawtimers();
+
       if (savedispcnt > 0.0)  // if there's a message, display it
       {
         drawtext(0, dispmessage);
@@ -2921,6 +5291,10 @@ nochmal:
   }
 
 ende:  // program ending, free all
+  timerstop();
+  capturestop();
+  exportpoll(true);
+  if (ttd) checkpointwait();
   TTF_CloseFont(font);
   TTF_Quit();
   if (ttd) {
@@ -11,6 +11,17 @@ void main()
 	int a;
 
 	a = int(gl_TexCoord[1].x);
+#ifdef FOUR
+	// copy the second complex number (ba) of a 4 channel buffer
+	if ((a/2)*2==a)
+	{
+		gl_FragColor.r = texture1D (tex0, gl_TexCoord[0].x).b;
+	}
+	else
+	{
+		gl_FragColor.r = texture1D (tex0, gl_TexCoord[0].x).a;
+	}
+#else
 	if ((a/2)*2==a)
 	{
 		gl_FragColor.r = texture1D (tex0, gl_TexCoord[0].x).r;
@@ -19,4 +30,5 @@ void main()
 	{
 		gl_FragColor.r = texture1D (tex0, gl_TexCoord[0].x).g;
 	}
+#endif
 }
@@ -1,7 +1,7 @@
 
 void main()
 {
-	gl_TexCoord[0] = gl_MultiTexCoord0;
+	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;	// unit quad placed in the texture by drawa
 	gl_TexCoord[1] = gl_MultiTexCoord1;
 	gl_Position = ftransform();
 }
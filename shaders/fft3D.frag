@@ -3,12 +3,14 @@
 // 3D fft
 
 
-uniform int dim, tang;
+uniform int dim, tang, radix;
 uniform float tangsc;
 
 uniform sampler3D tex0;
 uniform sampler1D tex1;
 
+vec3 v;
+
 
 vec2 cmul (vec2 a, vec2 b)
 {
@@ -16,46 +18,76 @@ vec2 cmul (vec2 a, vec2 b)
 }
 
 
+// with FOUR defined a texel holds two complex numbers (rg and ba), they
+// get the same butterflies
+#ifdef FOUR
+#define CVEC vec4
+#define CH rgba
+
+vec4 cmulw (vec4 a, vec2 w)
+{
+	return vec4 (cmul (a.xy, w), cmul (a.zw, w));
+}
+
+vec4 conj (vec4 a)
+{
+	return vec4 (a.x, -a.y, a.z, -a.w);
+}
+#else
+#define CVEC vec2
+#define CH rg
+
+vec2 cmulw (vec2 a, vec2 w)
+{
+	return cmul (a, w);
+}
+
+vec2 conj (vec2 a)
+{
+	return vec2 (a.x, -a.y);
+}
+#endif
+
+// source c of the butterfly in direction dim
+CVEC fetch (float c)
+{
+	if (dim==1) return texture3D (tex0, vec3 (c, v.y, v.z)).CH;
+	else if (dim==2) return texture3D (tex0, vec3 (v.x, c, v.z)).CH;
+	else return texture3D (tex0, vec3 (v.x, v.y, c)).CH;
+}
+
+
 void main()
 {
-	vec2 a, b;
-	vec3 v;
+	CVEC a, b;
 	vec4 p;
 
 	v = gl_TexCoord[0].xyz;
 
-	if (dim==1)
+	if (dim==1) p = texture1D (tex1, gl_TexCoord[1].x).rgba;
+	else if (dim==2) p = texture1D (tex1, gl_TexCoord[1].y).rgba;
+	else p = texture1D (tex1, gl_TexCoord[1].z).rgba;
+
+	a = fetch (p.r);
+	b = fetch (p.g);
+	if (tang==1)
 	{
-		p = texture1D (tex1, gl_TexCoord[1].x).rgba;
-		a = texture3D (tex0, vec3 (p.r, v.y, v.z)).rg;
-		b = texture3D (tex0, vec3 (p.g, v.y, v.z)).rg;
-		if (tang==1)
-		{
-			b.y = -b.y;
-			gl_FragColor.rg = (a+b + cmul (a-b, p.ba))*tangsc;
-		}
-		else
-		{
-			gl_FragColor.r = (a.r + p.b*b.r - p.a*b.g)*(1.0/sqrt(2.0));
-			gl_FragColor.g = (a.g + p.b*b.g + p.a*b.r)*(1.0/sqrt(2.0));
-		}
+		b = conj (b);
+		gl_FragColor.CH = (a+b + cmulw (a-b, p.ba))*tangsc;
 	}
-	else if (dim==2)
+	else if (radix==2)
 	{
-		p = texture1D (tex1, gl_TexCoord[1].y).rgba;
-		a = texture3D (tex0, vec3 (v.x, p.r, v.z)).rg;
-		b = texture3D (tex0, vec3 (v.x, p.g, v.z)).rg;
-		//gl_FragColor.rg = (a + cmul (p.ba,b))*(1.0/sqrt(2.0));
-		gl_FragColor.r = (a.r + p.b*b.r - p.a*b.g)*(1.0/sqrt(2.0));
-		gl_FragColor.g = (a.g + p.b*b.g + p.a*b.r)*(1.0/sqrt(2.0));
+		gl_FragColor.CH = (a + cmulw (b, p.ba))*(1.0/sqrt(2.0));
 	}
-	else // dim==3
+	else
 	{
-		p = texture1D (tex1, gl_TexCoord[1].z).rgba;
-		a = texture3D (tex0, vec3 (v.x, v.y, p.r)).rg;
-		b = texture3D (tex0, vec3 (v.x, v.y, p.g)).rg;
-		gl_FragColor.r = (a.r + p.b*b.r - p.a*b.g)*(1.0/sqrt(2.0));
-		gl_FragColor.g = (a.g + p.b*b.g + p.a*b.r)*(1.0/sqrt(2.0));
+		// radix r stage, r equally spaced sources times the twiddle
+		// p.ba^t, summed as Horner scheme
+		CVEC s = fetch (p.r + float(radix-1)*(p.g-p.r));
+		for (int t=radix-2; t>1; t--)
+			s = cmulw (s, p.ba) + fetch (p.r + float(t)*(p.g-p.r));
+		s = cmulw (cmulw (s, p.ba) + b, p.ba) + a;
+		gl_FragColor.CH = s*inversesqrt (float(radix));
 	}
 
 }
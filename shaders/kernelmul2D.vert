@@ -3,5 +3,5 @@ void main()
 {
 	gl_TexCoord[0] = gl_MultiTexCoord0;
 	gl_TexCoord[1] = gl_MultiTexCoord1;
-	gl_Position = ftransform();
+	gl_Position = vec4 (gl_Vertex.xy, 0.0, 1.0);	// pass quads are in clip coordinates
 }
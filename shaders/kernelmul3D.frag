@@ -12,8 +12,13 @@ void main()
 {
 	vec2 a, b;
 
+	// the kernel spectra are real, one in each channel of tex1
 	a = texture3D (tex0, gl_TexCoord[0].xyz).rg;
 	b = texture3D (tex1, gl_TexCoord[1].xyz).rg*sc;
-	gl_FragColor.r = a.r*b.r - a.g*b.g;
-	gl_FragColor.g = a.r*b.g + a.g*b.r;
+	gl_FragColor.rg = a*b.r;
+
+#ifdef FOUR
+	// second kernel in the g channel of tex1, result in ba
+	gl_FragColor.ba = a*b.g;
+#endif
 }
@@ -8,7 +8,13 @@ const float pi = 6.283185307;
 
 uniform float b1, b2, d1, d2, sn, sm;
 
-uniform float mode, sigmode, sigtype, mixtype, dt;
+uniform float dt;
+
+// setShaders inserts mode, sigmode, sigtype and mixtype as constants in
+// front of the source for the snm variants, so the branches on them fold
+#ifndef SNMCONST
+uniform float mode, sigmode, sigtype, mixtype;
+#endif
 
 uniform sampler1D tex0;
 uniform sampler1D tex1;
@@ -1,8 +1,20 @@
 
+// slice from the vertex z for the layered 3D passes
+#ifdef LAYERED
+#ifdef GL_AMD_vertex_shader_layer
+#extension GL_AMD_vertex_shader_layer : enable
+#else
+#extension GL_ARB_shader_viewport_layer_array : enable
+#endif
+#endif
+
 void main()
 {
 	gl_TexCoord[0] = gl_MultiTexCoord0;
 	gl_TexCoord[1] = gl_MultiTexCoord1;
 	gl_TexCoord[2] = gl_MultiTexCoord2;
-	gl_Position = ftransform();
+	gl_Position = vec4 (gl_Vertex.xy, 0.0, 1.0);	// pass quads are in clip coordinates
+#ifdef LAYERED
+	gl_Layer = int (gl_Vertex.z);
+#endif
 }